@@ -5,6 +5,9 @@
 
 LUMINA_NAMESPACE_BEGIN
 
+/// Number of entries of the lookup tables of \ref Microfacet
+#define MICROFACET_TABLE_SIZE 256
+
 class Microfacet : public BSDF {
 public:
     Microfacet(const PropertyList& propList) {
@@ -29,71 +32,16 @@ public:
            interested in implementing a more realistic version
            of this BRDF. */
         m_ks = 1 - m_kd.maxCoeff();
+
+        /* Tabulate the Fresnel and shadowing terms, which trades a little accuracy for speed */
+        m_lookupTables = propList.getBoolean("lookupTables", false);
+        if (m_lookupTables)
+            buildTables();
     }
 
     /// Evaluate the BRDF for the given pair of directions
     Color3f eval(const BSDFQueryRecord& bRec) const {
-        if (Frame::cosTheta(bRec.wi) <= 0.0f || Frame::cosTheta(bRec.wo) <= 0.0f)
-            return Color3f(0.0f);
-
-        Color3f albedo = m_kd;
-        if (albedoTexture) {
-            Intersection its;
-            its.uv = bRec.uv;
-            albedo = albedoTexture.get()->evaluate(its);
-        }
-
-        float ks = m_ks, kd = 1 - ks;
-        if (metallicTexture) {
-            Intersection its;
-            its.uv = bRec.uv;
-
-            ks = metallicTexture.get()->evaluate(its);
-            kd = 1.0f - ks;
-
-            albedo = lerp(ks, Color3f(0.04), albedo);
-        }
-
-        Color3f diffusePart = albedo / M_PI;
-
-        Vector3f sumVector = bRec.wi + bRec.wo;
-        Vector3f wh = sumVector.normalized();
-
-        float fCoefficient = fresnel(wh.dot(bRec.wi), m_extIOR, m_intIOR);
-
-        Vector3f z_axis(0, 0, 1);
-        float cosThetai = bRec.wi.dot(z_axis), cosThetao = bRec.wo.dot(z_axis),
-            cosThetah = wh.dot(z_axis);
-
-        float roughness = m_alpha;
-        if (roughnessTexture) {
-            Intersection its;
-            its.uv = bRec.uv;
-            roughness = roughnessTexture.get()->evaluate(its);
-        }
-
-        float Gih = GShadowTerm(bRec.wi, wh, roughness), Goh = GShadowTerm(bRec.wo, wh, roughness);
-
-        float d = Warp::squareToBeckmannPdf(wh, roughness);
-
-        Color3f specularPart = ks * (d * fCoefficient * Gih * Goh) / (4.0f * cosThetah * cosThetai * cosThetao);
-
-        return diffusePart + specularPart;
-    }
-
-    float GShadowTerm(Vector3f wv, Vector3f wh, float roughness) const {
-        float cosThetav = Frame::cosTheta(wv);
-        float c = wv.dot(wh) / cosThetav;
-        float x = c > 0 ? 1 : 0;
-
-        float b = 1.0f / (roughness * tan(acos(cosThetav)));
-        float complexArg = 1.0f;
-        if (b < 1.6) {
-            float b2 = b * b;
-            complexArg = (3.535f * b + 2.181f * b2) / (1 + 2.276 * b + 2.577 * b2);
-        }
-
-        return x * complexArg;
+        return evalPdf(bRec, getRoughness(bRec), nullptr);
     }
 
     /// Evaluate the sampling density of \ref sample() wrt. solid angles
@@ -102,20 +50,7 @@ public:
             return 0.0f;
 
         Vector3f wh = (bRec.wi + bRec.wo).normalized();
-
-        float roughness = m_alpha;
-        if (roughnessTexture) {
-            Intersection its;
-            its.uv = bRec.uv;
-            roughness = roughnessTexture.get()->evaluate(its);
-        }
-
-        float D = Warp::squareToBeckmannPdf(wh, roughness);
-        float J = 1 / (4.0f * wh.dot(bRec.wo));
-
-        float cosThetao = Frame::cosTheta(bRec.wo);
-
-        return m_ks * D * J + (1 - m_ks) * cosThetao * INV_PI;
+        return density(bRec, wh, beckmann(Frame::cosTheta(wh), getRoughness(bRec)));
     }
 
     /// Sample the BRDF
@@ -124,12 +59,7 @@ public:
             return Color3f(0.0f);
         bRec.measure = ESolidAngle;
 
-        float roughness = m_alpha;
-        if (roughnessTexture) {
-            Intersection its;
-            its.uv = bRec.uv;
-            roughness = roughnessTexture.get()->evaluate(its);
-        }
+        float roughness = getRoughness(bRec);
         //Remap sample to [0, 1] distribution because sample.x() will not be in the range
         if (_sample.x() < m_ks) {
             Point2f sampleReuse(_sample.x() / m_ks, _sample.y());
@@ -146,13 +76,13 @@ public:
         if (Frame::cosTheta(bRec.wo) < 0.0f)
             return Color3f(0.0f);
 
-        return eval(bRec) * Frame::cosTheta(bRec.wo) / pdf(bRec);
+        /* eval() * cos(theta_o) / pdf(), with the terms both share computed once */
+        float pdf;
+        Color3f value = evalPdf(bRec, roughness, &pdf);
+        if (pdf <= 0.0f)
+            return Color3f(0.0f);
 
-        // Note: Once you have implemented the part that computes the scattered
-        // direction, the last part of this function should simply return the
-        // BRDF value divided by the solid angle density and multiplied by the
-        // cosine factor from the reflection equation, i.e.
-        // return eval(bRec) * Frame::cosTheta(bRec.wo) / pdf(bRec);
+        return value * Frame::cosTheta(bRec.wo) / pdf;
     }
 
     bool isDiffuse() const {
@@ -201,16 +131,142 @@ public:
             "  intIOR = %f,\n"
             "  extIOR = %f,\n"
             "  kd = %s,\n"
-            "  ks = %f\n"
+            "  ks = %f,\n"
+            "  lookupTables = %s\n"
             "]",
             m_alpha,
             m_intIOR,
             m_extIOR,
             m_kd.toString(),
-            m_ks
+            m_ks,
+            m_lookupTables ? "true" : "false"
         );
     }
 private:
+    float getRoughness(const BSDFQueryRecord& bRec) const {
+        if (!roughnessTexture)
+            return m_alpha;
+
+        Intersection its;
+        its.uv = bRec.uv;
+        return roughnessTexture.get()->evaluate(its);
+    }
+
+    /**
+     * \brief Density of \ref sample() for directions above the surface
+     *
+     * \param wh
+     *     Half vector of \c bRec.wi and \c bRec.wo
+     * \param D
+     *     Beckmann density of \c wh
+     */
+    float density(const BSDFQueryRecord& bRec, const Vector3f& wh, float D) const {
+        return m_ks * D / (4.0f * wh.dot(bRec.wo)) + (1 - m_ks) * Frame::cosTheta(bRec.wo) * INV_PI;
+    }
+
+    /**
+     * \brief Evaluate the BRDF and, unless \c pdf is null, the density of \ref sample()
+     *
+     * Both need the half vector and the Beckmann distribution, which this
+     * computes only once.
+     */
+    Color3f evalPdf(const BSDFQueryRecord& bRec, float roughness, float* pdf) const {
+        if (pdf)
+            *pdf = 0.0f;
+        float cosThetai = Frame::cosTheta(bRec.wi), cosThetao = Frame::cosTheta(bRec.wo);
+        if (cosThetai <= 0.0f || cosThetao <= 0.0f)
+            return Color3f(0.0f);
+
+        Color3f albedo = m_kd;
+        if (albedoTexture) {
+            Intersection its;
+            its.uv = bRec.uv;
+            albedo = albedoTexture.get()->evaluate(its);
+        }
+
+        float ks = m_ks;
+        if (metallicTexture) {
+            Intersection its;
+            its.uv = bRec.uv;
+
+            ks = metallicTexture.get()->evaluate(its);
+            albedo = lerp(ks, Color3f(0.04), albedo);
+        }
+
+        Color3f diffusePart = albedo * INV_PI;
+
+        Vector3f wh = (bRec.wi + bRec.wo).normalized();
+        float cosThetah = Frame::cosTheta(wh);
+        float whDotWi = wh.dot(bRec.wi), whDotWo = wh.dot(bRec.wo);
+
+        float D = beckmann(cosThetah, roughness);
+        if (pdf)
+            *pdf = density(bRec, wh, D);
+
+        float F = m_lookupTables ? lookup(m_fresnelTable, whDotWi) : fresnel(whDotWi, m_extIOR, m_intIOR);
+        float G = shadowing(cosThetai, whDotWi, roughness) * shadowing(cosThetao, whDotWo, roughness);
+
+        Color3f specularPart = ks * (D * F * G) / (4.0f * cosThetah * cosThetai * cosThetao);
+
+        return diffusePart + specularPart;
+    }
+
+    /// Density of Beckmann-distributed half vectors with respect to solid angles, see \ref Warp::squareToBeckmannPdf()
+    static float beckmann(float cosThetah, float roughness) {
+        if (cosThetah <= 0.0f)
+            return 0.0f;
+
+        float cos2Thetah = cosThetah * cosThetah, alpha2 = roughness * roughness;
+        float tan2Thetah = (1.0f - cos2Thetah) / cos2Thetah;
+        return std::exp(-tan2Thetah / alpha2) / (M_PI * alpha2 * cos2Thetah * cosThetah);
+    }
+
+    /// Rational approximation of the Smith shadowing term of the Beckmann distribution, as a function of b = 1 / (alpha * tan(theta))
+    static float smithG1(float b) {
+        if (b >= 1.6f)
+            return 1.0f;
+
+        float b2 = b * b;
+        return (3.535f * b + 2.181f * b2) / (1 + 2.276f * b + 2.577f * b2);
+    }
+
+    /// Shadowing of the direction v by microfacets with normal h, given the cosines of v with the normal and h
+    float shadowing(float cosThetav, float vDotH, float roughness) const {
+        if (vDotH / cosThetav <= 0.0f)
+            return 0.0f;
+
+        float sinThetav = std::sqrt(std::max(0.0f, 1.0f - cosThetav * cosThetav));
+        if (sinThetav == 0.0f)
+            return 1.0f;
+
+        float b = cosThetav / (roughness * sinThetav);
+        if (!m_lookupTables || b >= 1.6f)
+            return smithG1(b);
+
+        /* The term only depends on b, one table covers all roughnesses */
+        static const std::vector<float> table = [] {
+            std::vector<float> values(MICROFACET_TABLE_SIZE);
+            for (int i = 0; i < MICROFACET_TABLE_SIZE; i++)
+                values[i] = smithG1(1.6f * i / (MICROFACET_TABLE_SIZE - 1));
+            return values;
+        }();
+        return lookup(table, b / 1.6f);
+    }
+
+    /// Tabulate the Fresnel term over cosines in [0, 1] for the IORs of the material
+    void buildTables() {
+        m_fresnelTable.resize(MICROFACET_TABLE_SIZE);
+        for (int i = 0; i < MICROFACET_TABLE_SIZE; i++)
+            m_fresnelTable[i] = fresnel((float) i / (MICROFACET_TABLE_SIZE - 1), m_extIOR, m_intIOR);
+    }
+
+    /// Linearly interpolate a table with entries evenly spaced over [0, 1]
+    static float lookup(const std::vector<float>& table, float x) {
+        x = std::min(std::max(x, 0.0f), 1.0f) * (MICROFACET_TABLE_SIZE - 1);
+        int i = std::min((int) x, MICROFACET_TABLE_SIZE - 2);
+        return lerp(x - i, table[i], table[i + 1]);
+    }
+
     float m_alpha;
     float m_intIOR, m_extIOR;
     float m_ks;
@@ -219,6 +275,10 @@ private:
     std::unique_ptr<Texture<Color3f>> albedoTexture;
     std::unique_ptr<Texture<float>> metallicTexture;
     std::unique_ptr<Texture<float>> roughnessTexture;
+
+    /// Interpolate the Fresnel and shadowing terms from tables instead of evaluating them
+    bool m_lookupTables;
+    std::vector<float> m_fresnelTable;
 };
 
 LUMINA_REGISTER_CLASS(Microfacet, "microfacet")
@@ -6,8 +6,18 @@
 
 #include <Eigen/Geometry>
 #include <Eigen/LU>
+#include <cstring>
 #include "object.h"
 
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
 LUMINA_NAMESPACE_BEGIN
 
 std::vector<std::string> tokenize(const std::string &s, const std::string &delim, bool includeEmpty) {
@@ -141,6 +151,43 @@ std::string memString(size_t size, bool precise) {
     return os.str();
 }
 
+size_t getPeakMemoryUsage() {
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return 0;
+    return (size_t) counters.PeakWorkingSetSize;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+#if defined(__APPLE__)
+    return (size_t) usage.ru_maxrss;
+#else
+    /* Linux reports kilobytes */
+    return (size_t) usage.ru_maxrss * 1024;
+#endif
+#endif
+}
+
+uint64_t hashBytes(const void *data, size_t size, uint64_t seed) {
+    const uint8_t *bytes = (const uint8_t *) data;
+    uint64_t hash = seed ^ 0xcbf29ce484222325ULL;
+
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, bytes + i, 8);
+        hash = (hash ^ word) * 0x100000001b3ULL;
+        /* Fold the high bits back down, the multiplication only carries upwards */
+        hash ^= hash >> 29;
+    }
+    for (; i < size; i++)
+        hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+
+    return hash;
+}
+
 Resolver* getFileResolver() {
     static Resolver* resolver = new Resolver();
 
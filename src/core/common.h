@@ -7,12 +7,17 @@
 #include <iostream>
 #include <algorithm>
 #include <vector>
+#include <cstring>
 #include <nanogui/button.h>
 #include <OpenEXRCore/openexr_version.h>
 #include <tbb/task.h>
 #include <Eigen/Core>
 #include <tinyformat/tinyformat.h>
 
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
 
 #include "utils/resolver.h"
 
@@ -32,6 +37,11 @@
 #define SQRT_TWO     1.41421356237309504880f
 #define INV_SQRT_TWO 0.70710678118654752440f
 
+/* SSE kernels are used when available, define LUMINA_NO_SSE to force the scalar versions */
+#if !defined(LUMINA_NO_SSE) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define LUMINA_HAS_SSE 1
+#endif
+
 LUMINA_NAMESPACE_BEGIN
 template <typename Scalar, int Dimension> struct TVector;
 template <typename Scalar, int Dimension> struct TPoint;
@@ -100,6 +110,9 @@ class Scene;
 
 typedef Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic> MatrixXf;
 typedef Eigen::Matrix<uint32_t, Eigen::Dynamic, Eigen::Dynamic> MatrixXu;
+/// Read-only views of matrix data that is owned elsewhere (e.g. a memory-mapped file)
+typedef Eigen::Map<const MatrixXf> ConstMatrixXfMap;
+typedef Eigen::Map<const MatrixXu> ConstMatrixXuMap;
 
 enum EMeasure {
     EUnknownMeasure = 0,
@@ -125,6 +138,12 @@ std::string timeString(double time, bool precise = false);
 
 std::string memString(size_t size, bool precise = false);
 
+/// Return the peak resident memory of the process so far in bytes (0 if unavailable)
+size_t getPeakMemoryUsage();
+
+/// Hash a block of memory (64-bit FNV-1a variant working on 8-byte words, not cryptographic)
+uint64_t hashBytes(const void *data, size_t size, uint64_t seed = 0);
+
 Resolver* getFileResolver();
 
 std::vector<std::string> tokenize(const std::string& s, const std::string& delim = ", ", bool includeEmpty = false);
@@ -153,6 +172,37 @@ inline float inverseGammaCorrect(float value) {
 
 inline float lerp(float t, float v1, float v2) { return (1 - t) * v1 + t * v2; }
 
+/**
+ * \brief Atomically add \c value to the float at \c dst
+ *
+ * C++17 has no atomic floating point addition, so this is a
+ * compare-and-swap loop on the bit pattern of the float.
+ */
+inline void atomicAdd(float *dst, float value) {
+#if defined(_MSC_VER)
+    volatile long *bits = reinterpret_cast<volatile long *>(dst);
+    long expected = *bits, desired, previous;
+    while (true) {
+        float sum;
+        memcpy(&sum, &expected, sizeof(float));
+        sum += value;
+        memcpy(&desired, &sum, sizeof(float));
+        if ((previous = _InterlockedCompareExchange(bits, desired, expected)) == expected)
+            break;
+        expected = previous;
+    }
+#else
+    uint32_t *bits = reinterpret_cast<uint32_t *>(dst);
+    uint32_t expected = __atomic_load_n(bits, __ATOMIC_RELAXED), desired;
+    do {
+        float sum;
+        memcpy(&sum, &expected, sizeof(float));
+        sum += value;
+        memcpy(&desired, &sum, sizeof(float));
+    } while (!__atomic_compare_exchange_n(bits, &expected, desired, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+#endif
+}
+
 template <typename T>
 inline bool isPower2(T v) {
     return v && !(v & (v - 1));
@@ -4,10 +4,11 @@
 
 #include "block.h"
 #include "primitives/bbox.h"
+#include "utils/stats.h"
 
 LUMINA_NAMESPACE_BEGIN
 
-ImageBlock::ImageBlock(const Vector2i &size, const ReconstructionFilter *filter)
+ImageBlock::ImageBlock(const Vector2i &size, const ReconstructionFilter *filter, bool trackVariance)
         : m_offset(0, 0), m_size(size) {
     if (filter) {
         /* Tabulate the image reconstruction filter for performance reasons */
@@ -29,6 +30,9 @@ ImageBlock::ImageBlock(const Vector2i &size, const ReconstructionFilter *filter)
 
     /* Allocate space for pixels and border regions */
     resize(size.y() + 2*m_borderSize, size.x() + 2*m_borderSize);
+
+    if (trackVariance)
+        m_moments.setZero(size.x() * size.y(), 3);
 }
 
 ImageBlock::~ImageBlock() {
@@ -56,6 +60,7 @@ void ImageBlock::fromBitmap(const Bitmap &bitmap) {
 
 void ImageBlock::put(const Point2f &_pos, const Color3f &value) {
     if (!value.isValid()) {
+        Statistics::count(EInvalidSamples);
         /* If this happens, go fix your code instead of removing this warning ;) */
         std::cerr << "Integrator: computed an invalid radiance value: " << value.toString() << "\n";
         return;
@@ -83,6 +88,15 @@ void ImageBlock::put(const Point2f &_pos, const Color3f &value) {
     for (int y=bbox.min.y(), yr=0; y<=bbox.max.y(); ++y, ++yr)
         for (int x=bbox.min.x(), xr=0; x<=bbox.max.x(); ++x, ++xr)
             coeffRef(y, x) += Color4f(value) * m_weightsX[xr] * m_weightsY[yr];
+
+    if (m_moments.size() > 0) {
+        /* Statistics are kept for the pixel that the sample lies in, ignoring the filter */
+        int x = (int) std::floor(_pos.x()) - m_offset.x(), y = (int) std::floor(_pos.y()) - m_offset.y();
+        if (x >= 0 && x < m_size.x() && y >= 0 && y < m_size.y()) {
+            double luminance = value.getLuminance();
+            m_moments.row(y * getMomentStride() + x) += Eigen::Array3d(1.0, luminance, luminance * luminance).transpose();
+        }
+    }
 }
 
 void ImageBlock::put(ImageBlock &b) {
@@ -90,10 +104,65 @@ void ImageBlock::put(ImageBlock &b) {
                       Vector2i::Constant(m_borderSize - b.getBorderSize());
     Vector2i size   = b.getSize()   + Vector2i(2*b.getBorderSize());
 
-    tbb::mutex::scoped_lock lock(m_mutex);
+    /* Rectangle (relative to b's storage) that no other block splats into */
+    int inner = 2*b.getBorderSize();
+    Vector2i innerSize = (b.getSize() - Vector2i::Constant(2*b.getBorderSize())).cwiseMax(Vector2i::Zero());
+
+    block(offset.y() + inner, offset.x() + inner, innerSize.y(), innerSize.x())
+            += b.block(inner, inner, innerSize.y(), innerSize.x());
+
+    for (int y = 0; y < size.y(); ++y) {
+        bool innerRow = y >= inner && y < inner + innerSize.y();
+        for (int x = 0; x < size.x(); ++x) {
+            if (innerRow && x >= inner && x < inner + innerSize.x()) {
+                x = inner + innerSize.x() - 1;
+                continue;
+            }
+
+            const Color4f &src = b.coeff(y, x);
+            Color4f &dst = coeffRef(offset.y() + y, offset.x() + x);
+            for (int i = 0; i < 4; ++i) {
+                if (src[i] != 0)
+                    atomicAdd(&dst[i], src[i]);
+            }
+        }
+    }
+
+    /* Statistics only cover the block's own pixels, which are disjoint */
+    if (m_moments.size() > 0 && b.m_moments.size() > 0) {
+        Vector2i momentOffset = b.getOffset() - m_offset;
+        for (int y = 0; y < b.getSize().y(); ++y)
+            m_moments.middleRows((y + momentOffset.y()) * getMomentStride() + momentOffset.x(), b.getSize().x())
+                    += b.m_moments.middleRows(y * b.getMomentStride(), b.getSize().x());
+    }
+}
+
+float ImageBlock::getRelativeError(const Point2i &offset, const Vector2i &size) const {
+    if (m_moments.size() == 0)
+        return std::numeric_limits<float>::infinity();
+
+    double varianceSum = 0, meanSum = 0;
+    for (int y = offset.y() - m_offset.y(); y < offset.y() - m_offset.y() + size.y(); ++y) {
+        for (int x = offset.x() - m_offset.x(); x < offset.x() - m_offset.x() + size.x(); ++x) {
+            double count = m_moments(y * getMomentStride() + x, 0);
+            if (count < 2)
+                return std::numeric_limits<float>::infinity();
+
+            double mean = m_moments(y * getMomentStride() + x, 1) / count;
+            double variance = std::max(0.0, m_moments(y * getMomentStride() + x, 2) / count - mean * mean)
+                              * count / (count - 1);
+
+            /* Variance of the pixel estimate, which averages 'count' samples */
+            varianceSum += variance / count;
+            meanSum += mean;
+        }
+    }
+
+    if (varianceSum == 0)
+        return 0.0f;
 
-    block(offset.y(), offset.x(), size.y(), size.x())
-            += b.topLeftCorner(size.y(), size.x());
+    double pixelCount = (double) size.x() * size.y();
+    return (float) (std::sqrt(varianceSum / pixelCount) / std::max(meanSum / pixelCount, 1e-3));
 }
 
 std::string ImageBlock::toString() const {
@@ -101,47 +170,119 @@ std::string ImageBlock::toString() const {
                        m_offset.toString(), m_size.toString());
 }
 
-BlockGenerator::BlockGenerator(const Vector2i &size, int blockSize)
-        : m_size(size), m_blockSize(blockSize) {
-    m_numBlocks = Vector2i(
+namespace {
+    /// Interleave the bits of the block coordinates (z-order curve)
+    inline uint32_t mortonIndex(uint32_t x, uint32_t y) {
+        auto spread = [](uint32_t v) {
+            v &= 0x0000ffff;
+            v = (v | (v << 8)) & 0x00ff00ff;
+            v = (v | (v << 4)) & 0x0f0f0f0f;
+            v = (v | (v << 2)) & 0x33333333;
+            v = (v | (v << 1)) & 0x55555555;
+            return v;
+        };
+        return spread(x) | (spread(y) << 1);
+    }
+
+    /// Distance along the Hilbert curve that fills an n x n grid (n being a power of two)
+    inline uint32_t hilbertIndex(uint32_t n, uint32_t x, uint32_t y) {
+        uint32_t index = 0;
+        for (uint32_t s = n / 2; s > 0; s /= 2) {
+            uint32_t rx = (x & s) > 0, ry = (y & s) > 0;
+            index += s * s * ((3 * rx) ^ ry);
+
+            /* Rotate the quadrant so that the curve continues correctly */
+            if (ry == 0) {
+                if (rx == 1) {
+                    x = n - 1 - x;
+                    y = n - 1 - y;
+                }
+                std::swap(x, y);
+            }
+        }
+        return index;
+    }
+}
+
+BlockGenerator::BlockGenerator(const Vector2i &size, int blockSize, EOrder order)
+        : m_size(size), m_blockSize(blockSize), m_nextBlock(0) {
+    Vector2i numBlocks(
             (int) std::ceil(size.x() / (float) blockSize),
             (int) std::ceil(size.y() / (float) blockSize));
-    m_blocksLeft = m_numBlocks.x() * m_numBlocks.y();
-    m_direction = ERight;
-    m_block = Point2i(m_numBlocks / 2);
-    m_stepsLeft = 1;
-    m_numSteps = 1;
+    m_blocks.reserve(numBlocks.x() * numBlocks.y());
+
+    if (order == ESpiral) {
+        generateSpiral(numBlocks);
+        return;
+    }
+
+    for (int y = 0; y < numBlocks.y(); ++y)
+        for (int x = 0; x < numBlocks.x(); ++x)
+            m_blocks.emplace_back(x, y);
+
+    if (order == EMorton) {
+        std::sort(m_blocks.begin(), m_blocks.end(), [](const Point2i &a, const Point2i &b) {
+            return mortonIndex(a.x(), a.y()) < mortonIndex(b.x(), b.y());
+        });
+    } else if (order == EHilbert) {
+        uint32_t n = (uint32_t) roundUpPow2((int32_t) std::max(numBlocks.x(), numBlocks.y()));
+        std::sort(m_blocks.begin(), m_blocks.end(), [n](const Point2i &a, const Point2i &b) {
+            return hilbertIndex(n, a.x(), a.y()) < hilbertIndex(n, b.x(), b.y());
+        });
+    }
 }
 
-bool BlockGenerator::next(ImageBlock &block) {
-    tbb::mutex::scoped_lock lock(m_mutex);
+BlockGenerator::EOrder BlockGenerator::parseOrder(const std::string &name) {
+    std::string order = toLower(name);
+    if (order == "spiral")
+        return ESpiral;
+    else if (order == "scanline")
+        return EScanline;
+    else if (order == "morton")
+        return EMorton;
+    else if (order == "hilbert")
+        return EHilbert;
 
-    if (m_blocksLeft == 0)
-        return false;
+    throw LuminaException("Unknown block order \"%s\", expected \"spiral\", \"scanline\", \"morton\" or \"hilbert\"", name);
+}
 
-    Point2i pos = m_block * m_blockSize;
-    block.setOffset(pos);
-    block.setSize((m_size - pos).cwiseMin(Vector2i::Constant(m_blockSize)));
+void BlockGenerator::generateSpiral(const Vector2i &numBlocks) {
+    int blocksLeft = numBlocks.x() * numBlocks.y();
+    int direction = ERight, stepsLeft = 1, numSteps = 1;
+    Point2i block(numBlocks / 2);
 
-    if (--m_blocksLeft == 0)
-        return true;
+    while (true) {
+        m_blocks.push_back(block);
+        if (--blocksLeft == 0)
+            break;
 
-    do {
-        switch (m_direction) {
-            case ERight: ++m_block.x(); break;
-            case EDown:  ++m_block.y(); break;
-            case ELeft:  --m_block.x(); break;
-            case EUp:    --m_block.y(); break;
-        }
+        do {
+            switch (direction) {
+                case ERight: ++block.x(); break;
+                case EDown:  ++block.y(); break;
+                case ELeft:  --block.x(); break;
+                case EUp:    --block.y(); break;
+            }
 
-        if (--m_stepsLeft == 0) {
-            m_direction = (m_direction + 1) % 4;
-            if (m_direction == ELeft || m_direction == ERight)
-                ++m_numSteps;
-            m_stepsLeft = m_numSteps;
-        }
-    } while ((m_block.array() < 0).any() ||
-             (m_block.array() >= m_numBlocks.array()).any());
+            if (--stepsLeft == 0) {
+                direction = (direction + 1) % 4;
+                if (direction == ELeft || direction == ERight)
+                    ++numSteps;
+                stepsLeft = numSteps;
+            }
+        } while ((block.array() < 0).any() ||
+                 (block.array() >= numBlocks.array()).any());
+    }
+}
+
+bool BlockGenerator::next(ImageBlock &block) {
+    int index = m_nextBlock.fetch_add(1, std::memory_order_relaxed);
+    if (index >= (int) m_blocks.size())
+        return false;
+
+    Point2i pos = m_blocks[index] * m_blockSize;
+    block.setOffset(pos);
+    block.setSize((m_size - pos).cwiseMin(Vector2i::Constant(m_blockSize)));
 
     return true;
 }
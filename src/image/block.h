@@ -8,7 +8,7 @@
 #include "core/color.h"
 #include "rfilter.h"
 #include "bitmap.h"
-#include <oneapi/tbb/mutex.h>
+#include <atomic>
 
 #define LUMINA_BLOCK_SIZE 32
 
@@ -37,8 +37,11 @@ LUMINA_NAMESPACE_BEGIN
          * \param filter
          *     Samples will be convolved with the image reconstruction
          *     filter provided here.
+         * \param trackVariance
+         *     Also record per-pixel luminance statistics, which are
+         *     needed by \ref getRelativeError()
          */
-        ImageBlock(const Vector2i &size, const ReconstructionFilter *filter);
+        ImageBlock(const Vector2i &size, const ReconstructionFilter *filter, bool trackVariance = false);
 
         /// Release all memory
         ~ImageBlock();
@@ -70,7 +73,7 @@ LUMINA_NAMESPACE_BEGIN
         void fromBitmap(const Bitmap &bitmap);
 
         /// Clear all contents
-        void clear() { setConstant(Color4f()); }
+        void clear() { setConstant(Color4f()); m_moments.setZero(); }
 
         /// Record a sample with the given position and radiance value
         void put(const Point2f &pos, const Color3f &value);
@@ -78,20 +81,39 @@ LUMINA_NAMESPACE_BEGIN
         /**
          * \brief Merge another image block into this one
          *
-         * During the merge operation, this function locks
-         * the destination block using a mutex.
+         * The merge does not lock. The part of \c b that no other block of
+         * the same \ref BlockGenerator overlaps is added directly, the
+         * filter border that neighboring blocks share is added atomically,
+         * so concurrent merges of different blocks are safe.
          */
         void put(ImageBlock &b);
 
-        /// Lock the image block (using an internal mutex)
-        inline void lock() const { m_mutex.lock(); }
+        /// Return whether per-pixel luminance statistics are recorded
+        bool isTrackingVariance() const { return m_moments.size() > 0; }
 
-        /// Unlock the image block
-        inline void unlock() const { m_mutex.unlock(); }
+        /**
+         * \brief Estimate the relative error of the mean luminance of a region
+         *
+         * Computes the root mean square of the per-pixel standard errors
+         * divided by the mean pixel luminance of the region (at least
+         * 10^-3, so that almost black regions are not held to a relative
+         * standard they can hardly reach). Requires
+         * variance tracking and at least two samples in every pixel,
+         * otherwise returns infinity.
+         *
+         * \param offset
+         *     Offset of the region within the main image
+         * \param size
+         *     Size of the region
+         */
+        float getRelativeError(const Point2i &offset, const Vector2i &size) const;
 
         /// Return a human-readable string summary
         std::string toString() const;
     protected:
+        /// Number of pixels per row of \ref m_moments (the allocated block width)
+        int getMomentStride() const { return (int) cols() - 2*m_borderSize; }
+
         Point2i m_offset;
         Vector2i m_size;
         int m_borderSize = 0;
@@ -100,51 +122,70 @@ LUMINA_NAMESPACE_BEGIN
         float *m_weightsX = nullptr;
         float *m_weightsY = nullptr;
         float m_lookupFactor = 0;
-        mutable tbb::mutex m_mutex;
+        /// Sample count, luminance sum and sum of squared luminances of every pixel (without border)
+        Eigen::Array<double, Eigen::Dynamic, 3, Eigen::RowMajor> m_moments;
     };
 
 /**
- * \brief Spiraling block generator
+ * \brief Block generator
  *
  * This class can be used to chop up an image into many small
- * rectangular blocks suitable for parallel rendering. The blocks
- * are ordered in spiraling pattern so that the center is
- * rendered first.
+ * rectangular blocks suitable for parallel rendering. By default the
+ * blocks are ordered in spiraling pattern so that the center is
+ * rendered first, the space-filling orders instead keep consecutive
+ * blocks close to each other. The order is computed up front, so that
+ * handing out a block only takes an atomic increment.
  */
     class BlockGenerator {
     public:
+        /// Order in which the blocks are handed out
+        enum EOrder {
+            /// Center first, spiraling outwards
+            ESpiral = 0,
+            /// Row by row
+            EScanline,
+            /// Z-order curve
+            EMorton,
+            /// Hilbert curve
+            EHilbert
+        };
+
         /**
          * \brief Create a block generator with
          * \param size
          *      Size of the image that should be split into blocks
          * \param blockSize
          *      Maximum size of the individual blocks
+         * \param order
+         *      Order in which the blocks are handed out
          */
-        BlockGenerator(const Vector2i &size, int blockSize);
+        BlockGenerator(const Vector2i &size, int blockSize, EOrder order = ESpiral);
+
+        /// Parse the name of a block order ("spiral", "scanline", "morton" or "hilbert")
+        static EOrder parseOrder(const std::string &name);
 
         /**
          * \brief Return the next block to be rendered
          *
-         * This function is thread-safe
+         * This function is thread-safe and lock-free
          *
          * \return \c false if there were no more blocks
          */
         bool next(ImageBlock &block);
 
         /// Return the total number of blocks
-        int getBlockCount() const { return m_blocksLeft; }
+        int getBlockCount() const { return (int) m_blocks.size(); }
     protected:
         enum EDirection { ERight = 0, EDown, ELeft, EUp };
 
-        Point2i m_block;
-        Vector2i m_numBlocks;
+        /// Append all blocks of a \c numBlocks grid in spiral order
+        void generateSpiral(const Vector2i &numBlocks);
+
+        /// Block coordinates (in units of the block size) in the order they are handed out
+        std::vector<Point2i> m_blocks;
         Vector2i m_size;
         int m_blockSize;
-        int m_numSteps;
-        int m_blocksLeft;
-        int m_stepsLeft;
-        int m_direction;
-        tbb::mutex m_mutex;
+        std::atomic<int> m_nextBlock;
     };
 
 LUMINA_NAMESPACE_END
\ No newline at end of file
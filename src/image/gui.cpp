@@ -116,8 +116,9 @@ LuminaScreen::LuminaScreen(const ImageBlock &block)
 
 
 void LuminaScreen::draw_contents() {
-    // Reload the partially rendered image onto the GPU
-    m_block.lock();
+    // Reload the partially rendered image onto the GPU. Render threads keep
+    // merging into the block meanwhile, so a frame may show a block that is
+    // only partly merged; the next redraw shows it complete.
     const Vector2i &size = m_block.getSize();
     m_shader->set_uniform("scale", m_scale);
     m_renderPass->resize(framebuffer_size());
@@ -132,7 +133,6 @@ void LuminaScreen::draw_contents() {
     m_shader->end();
     m_renderPass->set_viewport(nanogui::Vector2i(0, 0), framebuffer_size());
     m_renderPass->end();
-    m_block.unlock();
 }
 
 LUMINA_NAMESPACE_END
\ No newline at end of file
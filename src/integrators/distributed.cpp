@@ -25,16 +25,15 @@ public:
         const BSDF* bsdf = its.mesh->getBSDF();
         if (bsdf->isDiffuse()) {
             float lightPdf;
-            Emitter* emitter = scene->sampleLight(sampler->next1D(), lightPdf);
+            Emitter* emitter = scene->sampleLight(its.p, its.shadingFrame.n, sampler->next1D(), lightPdf);
+            if (!emitter)
+                return Color3f(0.0f);
 
             EmitterQueryRecord emitterRecord(its.p, its.shadingFrame.n);
             Color3f emitterColor = emitter->sample(emitterRecord, sampler->next2D());
 
             Color3f directColor(0.0f);
-            Intersection shadowIts;
-            Ray3f shadowRay(its.p, emitterRecord.wi);
-            bool inShadow = scene->rayIntersect(shadowRay, shadowIts);
-            if (!inShadow || shadowIts.mesh->getEmitter() == emitter) {
+            if (isVisible(scene, emitterRecord)) {
                 BSDFQueryRecord bsdfRecord(its.toLocal(emitterRecord.wi), its.toLocal(-ray.d), ESolidAngle);
                 bsdfRecord.uv = its.uv;
                 Color3f albedo = its.mesh->getBSDF()->eval(bsdfRecord);
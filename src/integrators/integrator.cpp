@@ -0,0 +1,66 @@
+//
+// Created by agent on 10/17/26.
+//
+
+#include "integrator.h"
+
+LUMINA_NAMESPACE_BEGIN
+
+Ray3f Integrator::shadowRay(const Scene *scene, const EmitterQueryRecord &record, float &distance) {
+    /* The rounding error of hit points grows with their coordinates, so the offset follows the scene size */
+    float offset = Epsilon * std::max(1.0f, scene->getBoundingBox().getExtents().maxCoeff());
+    Point3f origin = record.refOrigin + record.refNormal * (record.refNormal.dot(record.wi) >= 0.0f ? offset : -offset);
+
+    if (std::isinf(record.distance)) {
+        distance = Infinity;
+        return Ray3f(origin, record.wi);
+    }
+
+    Vector3f direction = record.p - origin;
+    float length = direction.norm();
+    if (length == 0.0f) {
+        distance = 0.0f;
+        return Ray3f(origin, record.wi);
+    }
+
+    distance = length * (1.0f - Epsilon);
+    return Ray3f(origin, direction / length);
+}
+
+bool Integrator::isVisible(const Scene *scene, const EmitterQueryRecord &record) {
+    float distance;
+    Ray3f ray = shadowRay(scene, record, distance);
+
+    return !scene->occluded(ray, distance);
+}
+
+void Integrator::renderBlock(const Scene *scene, Sampler *sampler, ImageBlock &block, size_t sampleCount) const {
+    const Camera* camera = scene->getCamera();
+
+    Point2i offset = block.getOffset();
+    Vector2i size = block.getSize();
+
+    for (int y = 0; y < size.y(); y++) {
+        for (int x = 0; x < size.x(); x++) {
+            Point2i pixel(x + offset.x(), y + offset.y());
+            sampler->generate(pixel);
+
+            for (uint32_t i = 0; i < sampleCount; i++) {
+                if (i > 0)
+                    sampler->advance();
+
+                Point2f pixelSample = pixel.cast<float>() + sampler->next2D();
+                Point2f apertureSample = sampler->next2D();
+
+                Ray3f ray;
+                Color3f value = camera->sampleRay(ray, pixelSample, apertureSample);
+
+                value *= Li(scene, sampler, ray);
+
+                block.put(pixelSample, value);
+            }
+        }
+    }
+}
+
+LUMINA_NAMESPACE_END
@@ -40,6 +40,30 @@ public:
      */
     virtual Color3f Li(const Scene *scene, Sampler *sampler, const Ray3f &ray) const = 0;
 
+    /**
+     * \brief Accumulate \c sampleCount samples of every pixel into a block
+     *
+     * The sampler has already been prepared for the block. The default
+     * implementation traces the camera rays one at a time with \ref Li().
+     */
+    virtual void renderBlock(const Scene *scene, Sampler *sampler, ImageBlock &block, size_t sampleCount) const;
+
+    /**
+     * \brief Build the shadow ray from the reference point of the query
+     * record to the position sampled on an emitter
+     *
+     * The origin is moved off the surface along the reference normal, to
+     * the side of the emitter, by \ref Epsilon times the extent of the
+     * scene, and the ray is aimed at the sampled position again from there.
+     * \c distance receives the largest distance at which an occluder
+     * counts, just short of the sampled position, so the target emitter
+     * itself never counts as an occluder.
+     */
+    static Ray3f shadowRay(const Scene *scene, const EmitterQueryRecord &record, float &distance);
+
+    /// Check whether the position sampled on an emitter is visible along \ref shadowRay()
+    static bool isVisible(const Scene *scene, const EmitterQueryRecord &record);
+
     /**
      * \brief Return the type of object (i.e. Mesh/BSDF/etc.)
      * provided by this instance
@@ -3,6 +3,7 @@
 //
 
 #include "integrator.h"
+#include "utils/stats.h"
 #include "utils/warp.h"
 
 LUMINA_NAMESPACE_BEGIN
@@ -35,15 +36,16 @@ public:
             Color3f bsdfColor = its.mesh->getBSDF()->sample(record, sampler->next2D());
 
             float lightPdf;
-            Emitter* emitter = scene->sampleLight(sampler->next1D(), lightPdf);
+            Emitter* emitter = scene->sampleLight(its.p, its.shadingFrame.n, sampler->next1D(), lightPdf);
+            Point2f lightSample = sampler->next2D();
 
-            EmitterQueryRecord emitterRecord(its.p, its.shadingFrame.n);
-            Color3f Le = emitter->sample(emitterRecord, sampler->next2D());
+            if (emitter) {
+                EmitterQueryRecord emitterRecord(its.p, its.shadingFrame.n);
+                Color3f Le = emitter->sample(emitterRecord, lightSample);
 
-            Intersection shadowIts;
-            Ray3f shadowRay(its.p + its.shadingFrame.n * 0.001f, emitterRecord.wi);
-            if (!scene->rayIntersect(shadowRay, shadowIts)) {
-                totalColor += Le * bsdfColor / (emitterRecord.pdf * lightPdf);
+                if (isVisible(scene, emitterRecord)) {
+                    totalColor += Le * bsdfColor / (emitterRecord.pdf * lightPdf);
+                }
             }
 
             throughput *= bsdfColor / (rrProb);
@@ -53,6 +55,7 @@ public:
                 rrProb = std::fmin(0.99f, throughput.maxCoeff() * eta * eta);
 
                 if (sampler->next1D() > rrProb) {
+                    Statistics::count(ERussianRouletteTerminations);
                     break;
                 }
             }
@@ -60,6 +63,7 @@ public:
             numBounces++;
         }
 
+        Statistics::sample(EPathLength, numBounces);
         return totalColor;
     }
 
@@ -2,6 +2,7 @@
 // Created by juperez on 5/29/23.
 //
 #include "integrator.h"
+#include "utils/stats.h"
 #include "utils/warp.h"
 
 LUMINA_NAMESPACE_BEGIN
@@ -40,6 +41,7 @@ LUMINA_NAMESPACE_BEGIN
                     rrProb = std::fmin(0.99f, throughput.maxCoeff() * eta * eta);
 
                     if (sampler->next1D() > rrProb) {
+                        Statistics::count(ERussianRouletteTerminations);
                         break;
                     }
                 }
@@ -47,6 +49,7 @@ LUMINA_NAMESPACE_BEGIN
                 numBounces++;
             }
 
+            Statistics::sample(EPathLength, numBounces);
             return totalColor;
         }
 
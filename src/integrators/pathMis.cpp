@@ -3,6 +3,7 @@
 //
 
 #include "integrator.h"
+#include "utils/stats.h"
 
 LUMINA_NAMESPACE_BEGIN
 
@@ -42,14 +43,17 @@ public:
 
             if (numBounces > 3) {
                 rrProb = std::fmin(0.99f, throughput.maxCoeff() * eta * eta);
-                if (sampler->next1D() > rrProb)
+                if (sampler->next1D() > rrProb) {
+                    Statistics::count(ERussianRouletteTerminations);
                     break;
+                }
             }
 
             someRay = Ray3f(its.p, its.toWorld(bsdfRecord.wo));
             numBounces++;
         }
 
+        Statistics::sample(EPathLength, numBounces);
         return totalColor;
     }
 
@@ -59,26 +63,33 @@ public:
 
         // Sample from light source
         float lightPdf;
-        Emitter* emitter = scene->sampleLight(sampler->next1D(), lightPdf);
+        Emitter* emitter = scene->sampleLight(its.p, its.shadingFrame.n, sampler->next1D(), lightPdf);
+        Point2f lightSample = sampler->next2D();
 
         EmitterQueryRecord emitterRecord(its.p, its.shadingFrame.n);
-        Color3f emitterColor = emitter->sample(emitterRecord, sampler->next2D());
-        convertToSolidAngle(emitterRecord);
+        Color3f emitterColor(0.0f);
+        float areaPdf = 0.0f;
+        emitterRecord.pdf = 0.0f;
+        if (emitter) {
+            emitterColor = emitter->sample(emitterRecord, lightSample);
+            areaPdf = emitterRecord.pdf;
+            convertToSolidAngle(emitterRecord);
+        }
 
         if (emitterRecord.pdf > 0.0f) {
             BSDFQueryRecord hypotheticalBsdfRecord(its.toLocal(emitterRecord.wi), 
                 its.toLocal(-ray.d), ESolidAngle);
             float hypoBsdfPdf = bsdf->pdf(hypotheticalBsdfRecord);
-            Color3f hypoBsdfColor = bsdf->eval(hypotheticalBsdfRecord)
-                * std::max(0.0f, hypotheticalBsdfRecord.wi.dot(its.shadingFrame.n));
+            /* Without a cosine factor: the sampled emitter value already contains both cosines of the geometric term */
+            Color3f hypoBsdfColor = bsdf->eval(hypotheticalBsdfRecord);
 
-            Ray3f shadowRay(its.p, emitterRecord.wi);
-            Intersection shadowIts;
-            bool hitObject = scene->rayIntersect(shadowRay, shadowIts);
-            if (!hitObject || shadowIts.mesh->getEmitter() == emitter) {
-                float emitterWeight = emitterRecord.pdf / (emitterRecord.pdf + hypoBsdfPdf);
+            if (isVisible(scene, emitterRecord)) {
+                /* The light is sampled with the product of the selection and emitter densities */
+                float emitterPdf = emitterRecord.pdf * lightPdf;
+                float emitterWeight = emitterPdf / (emitterPdf + hypoBsdfPdf);
 
-                finalColor += emitterColor * hypoBsdfColor * emitterWeight / lightPdf;
+                /* The emitter returns the radiance times the geometric term, which is sampled by area */
+                finalColor += emitterColor * hypoBsdfColor * emitterWeight / (areaPdf * lightPdf);
             }
         }
 
@@ -88,21 +99,21 @@ public:
         float bsdfPdf = bsdf->pdf(bsdfRecord);
 
         if (bsdfPdf > 0.0f) {
-            Ray3f shadowRay = Ray3f(its.p, its.toWorld(bsdfRecord.wi));
+            Ray3f shadowRay = Ray3f(its.p, its.toWorld(bsdfRecord.wo));
             Intersection newShadowIts;
             bool hitObject = scene->rayIntersect(shadowRay, newShadowIts);
 
             if (hitObject && newShadowIts.mesh->isEmitter()) {
-                Emitter* foundEmitter = newShadowIts.mesh->getEmitter();
+                Emitter* foundEmitter = scene->getLight(newShadowIts);
 
                 EmitterQueryRecord fakeEmitterRecord(shadowRay.o);
-                fakeEmitterRecord.wi = its.toWorld(bsdfRecord.wi);
+                fakeEmitterRecord.wi = its.toWorld(bsdfRecord.wo);
                 fakeEmitterRecord.n = newShadowIts.geoFrame.n;
                 fakeEmitterRecord.p = newShadowIts.p;
-                fakeEmitterRecord.pdf = foundEmitter->pdf();
+                fakeEmitterRecord.pdf = foundEmitter->pdf(fakeEmitterRecord);
 
                 convertToSolidAngle(fakeEmitterRecord);
-                float emitterPdf = fakeEmitterRecord.pdf;
+                float emitterPdf = fakeEmitterRecord.pdf * scene->pdfLight(its.p, its.shadingFrame.n, foundEmitter);
                 Color3f emitterColor = foundEmitter->eval(fakeEmitterRecord);
 
                 float bsdfSampleWeight = bsdfPdf / (bsdfPdf + emitterPdf);
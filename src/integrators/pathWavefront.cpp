@@ -0,0 +1,368 @@
+//
+// Created by agent on 10/17/26.
+//
+
+#include "integrator.h"
+#include "scene/raySort.h"
+#include "utils/stats.h"
+
+#include <unordered_map>
+
+LUMINA_NAMESPACE_BEGIN
+
+#define MAX_BOUNCES 6
+
+/**
+ * \brief Wavefront version of the \c path_mis integrator
+ *
+ * Instead of tracing one path at a time, a block generates a batch of
+ * camera paths (up to \c queueSize, default 16384) and advances all of
+ * them a bounce at a time in separate stages: intersect, add emission,
+ * shade in order of material (light and BSDF sampling), then trace the
+ * queued shadow rays and BSDF-sampled emitter rays. Terminated paths are
+ * compacted out of the queue after every bounce. Unless \c sortRays is
+ * false, secondary rays are reordered by origin and direction before each
+ * traversal stage (see \ref RaySorter). The estimator is the
+ * same as that of \c path_mis term for term, and every path draws the
+ * same sample dimensions in the same order (see \ref Sampler::setSample()),
+ * so both render the same image.
+ */
+class PathWavefrontIntegrator : public Integrator {
+public:
+    PathWavefrontIntegrator(const PropertyList& propsList) {
+        m_queueSize = propsList.getInteger("queueSize", 1 << 14);
+        if (m_queueSize <= 0)
+            throw LuminaException("The queue size must be positive");
+        m_sortRays = propsList.getBoolean("sortRays", true);
+    }
+
+    void preprocess(const Scene* scene) {
+        /* Number the distinct BSDFs, paths are shaded grouped by them */
+        m_materials.clear();
+        for (const Mesh* mesh : scene->getMeshes())
+            m_materials.emplace(mesh->getBSDF(), (uint32_t) m_materials.size());
+    }
+
+    Color3f Li(const Scene* scene, Sampler* sampler, const Ray3f& ray) const {
+        PathQueue queue;
+        queue.push(ray, sampler->getPixel(), sampler->getSampleIndex(), sampler->getDimension());
+        trace(scene, sampler, queue);
+
+        return queue.radiance[0];
+    }
+
+    void renderBlock(const Scene* scene, Sampler* sampler, ImageBlock& block, size_t sampleCount) const {
+        const Camera* camera = scene->getCamera();
+
+        Point2i offset = block.getOffset();
+        Vector2i size = block.getSize();
+        size_t pixelCount = (size_t) size.x() * size.y();
+        size_t chunkSamples = std::max((size_t) 1, (size_t) m_queueSize / pixelCount);
+
+        PathQueue queue;
+        std::vector<Point2f> pixelSamples;
+        std::vector<Color3f> weights;
+
+        for (size_t firstSample = 0; firstSample < sampleCount; firstSample += chunkSamples) {
+            size_t samples = std::min(chunkSamples, sampleCount - firstSample);
+            queue.clear();
+            pixelSamples.clear();
+            weights.clear();
+
+            for (int y = 0; y < size.y(); y++) {
+                for (int x = 0; x < size.x(); x++) {
+                    Point2i pixel(x + offset.x(), y + offset.y());
+
+                    for (size_t i = firstSample; i < firstSample + samples; i++) {
+                        /* Film and aperture position */
+                        Point2f cameraSamples[2];
+                        sampler->setSample(pixel, i, 0);
+                        sampler->fill2D(cameraSamples, 2);
+                        Point2f pixelSample = pixel.cast<float>() + cameraSamples[0];
+
+                        Ray3f ray;
+                        weights.push_back(camera->sampleRay(ray, pixelSample, cameraSamples[1]));
+                        pixelSamples.push_back(pixelSample);
+                        queue.push(ray, pixel, (uint32_t) i, sampler->getDimension());
+                    }
+                }
+            }
+
+            trace(scene, sampler, queue);
+
+            for (size_t i = 0; i < pixelSamples.size(); i++)
+                block.put(pixelSamples[i], weights[i] * queue.radiance[i]);
+        }
+    }
+
+    std::string toString() const {
+        return tfm::format("Path Wavefront Integrator[queueSize=%i, sortRays=%s]", m_queueSize,
+                           m_sortRays ? "true" : "false");
+    }
+
+private:
+    /// Light sample whose contribution counts if the segment to the light is unoccluded
+    struct ShadowRay {
+        uint32_t path;
+        Ray3f ray;
+        float distance;
+        Color3f contribution;
+    };
+
+    /// BSDF sample whose contribution counts if the ray hits an emitter
+    struct EmitterRay {
+        uint32_t path;
+        Ray3f ray;
+        Color3f weight;
+        float bsdfPdf;
+        /// Shading normal of the vertex, which the light selection probability depends on
+        Normal3f n;
+    };
+
+    /// State of a batch of paths, with one entry per path in each array
+    struct PathQueue {
+        std::vector<Ray3f> rays;
+        std::vector<Intersection> hits;
+        std::vector<Color3f> throughput;
+        std::vector<Color3f> radiance;
+        std::vector<float> eta;
+        std::vector<float> rrProb;
+        std::vector<uint8_t> foundLight;
+
+        /// Sample of every path and the next dimension it draws, see \ref Sampler::setSample()
+        std::vector<Point2i> pixels;
+        std::vector<uint32_t> sampleIndices;
+        std::vector<uint32_t> dimensions;
+
+        /// Paths that are still being traced, and the same grouped by material
+        std::vector<uint32_t> active, sorted;
+
+        /// Rays generated by shading whose contributions are added after tracing them
+        std::vector<ShadowRay> shadowRays;
+        std::vector<EmitterRay> emitterRays;
+
+        void push(const Ray3f& ray, const Point2i& pixel, uint32_t sampleIndex, uint32_t dimension) {
+            active.push_back((uint32_t) rays.size());
+            rays.push_back(ray);
+            hits.emplace_back();
+            throughput.emplace_back(1.0f);
+            radiance.emplace_back(0.0f);
+            eta.push_back(1.0f);
+            rrProb.push_back(0.99f);
+            foundLight.push_back(0);
+            pixels.push_back(pixel);
+            sampleIndices.push_back(sampleIndex);
+            dimensions.push_back(dimension);
+        }
+
+        void clear() {
+            rays.clear();
+            hits.clear();
+            throughput.clear();
+            radiance.clear();
+            eta.clear();
+            rrProb.clear();
+            foundLight.clear();
+            pixels.clear();
+            sampleIndices.clear();
+            dimensions.clear();
+            active.clear();
+        }
+    };
+
+    /// Trace all paths of the queue until they terminate
+    void trace(const Scene* scene, Sampler* sampler, PathQueue& queue) const {
+        RaySorter sorter(scene->getBoundingBox());
+
+        for (int bounce = 0; bounce < MAX_BOUNCES && !queue.active.empty(); bounce++) {
+            /* Camera rays of a block are coherent already */
+            if (m_sortRays && bounce > 0)
+                sorter.sort(queue.active, [&](uint32_t path) -> const Ray3f& { return queue.rays[path]; });
+            intersect(scene, queue, bounce);
+            addEmission(queue);
+            sortByMaterial(queue);
+            shade(scene, sampler, queue, bounce);
+
+            if (m_sortRays) {
+                sorter.sort(queue.shadowRays, [](const ShadowRay& shadowRay) -> const Ray3f& { return shadowRay.ray; });
+                sorter.sort(queue.emitterRays, [](const EmitterRay& emitterRay) -> const Ray3f& { return emitterRay.ray; });
+            }
+            traceShadowRays(scene, queue);
+            traceEmitterRays(scene, queue);
+        }
+
+        /* Paths that are left reached the bounce limit */
+        for (size_t i = 0; i < queue.active.size(); i++)
+            Statistics::sample(EPathLength, MAX_BOUNCES);
+    }
+
+    /// Find the next vertex of every active path, paths that leave the scene terminate
+    void intersect(const Scene* scene, PathQueue& queue, int bounce) const {
+        size_t count = 0;
+        for (uint32_t path : queue.active) {
+            if (scene->rayIntersect(queue.rays[path], queue.hits[path]))
+                queue.active[count++] = path;
+            else
+                Statistics::sample(EPathLength, bounce);
+        }
+        queue.active.resize(count);
+    }
+
+    /// Add the emission of the first emitter that each path hits
+    void addEmission(PathQueue& queue) const {
+        for (uint32_t path : queue.active) {
+            const Intersection& its = queue.hits[path];
+            if (!its.mesh->isEmitter() || queue.foundLight[path])
+                continue;
+
+            EmitterQueryRecord emitterRecord(its.p);
+            emitterRecord.n = its.geoFrame.n;
+            emitterRecord.wi = queue.rays[path].d;
+
+            queue.radiance[path] += queue.throughput[path] * its.mesh->getEmitter()->eval(emitterRecord);
+            queue.foundLight[path] = 1;
+        }
+    }
+
+    /// Counting sort of the active paths by the material at their vertex
+    void sortByMaterial(PathQueue& queue) const {
+        std::vector<uint32_t> offsets(m_materials.size() + 2, 0);
+        auto material = [&](uint32_t path) {
+            auto it = m_materials.find(queue.hits[path].mesh->getBSDF());
+            return it != m_materials.end() ? it->second + 1 : 0;
+        };
+
+        for (uint32_t path : queue.active)
+            offsets[material(path) + 1]++;
+        for (size_t i = 1; i < offsets.size(); i++)
+            offsets[i] += offsets[i - 1];
+
+        queue.sorted.resize(queue.active.size());
+        for (uint32_t path : queue.active)
+            queue.sorted[offsets[material(path)]++] = path;
+    }
+
+    /**
+     * \brief Sample a light and the BSDF at every vertex, and continue or terminate the paths
+     *
+     * The sampled light and the BSDF-sampled direction of multiple
+     * importance sampling become queued rays. The paths that survive
+     * Russian roulette become the active paths of the next bounce.
+     */
+    void shade(const Scene* scene, Sampler* sampler, PathQueue& queue, int bounce) const {
+        queue.shadowRays.clear();
+        queue.emitterRays.clear();
+        queue.active.clear();
+
+        for (uint32_t path : queue.sorted) {
+            const Intersection& its = queue.hits[path];
+            const Ray3f& ray = queue.rays[path];
+            const BSDF* bsdf = its.mesh->getBSDF();
+            const Color3f& throughput = queue.throughput[path];
+            sampler->setSample(queue.pixels[path], queue.sampleIndices[path], queue.dimensions[path]);
+
+            /* Light selection, then the light, MIS BSDF and continuation samples */
+            float lightSample = sampler->next1D();
+            Point2f samples[3];
+            sampler->fill2D(samples, 3);
+
+            /* Sample from light source */
+            float lightPdf;
+            Emitter* emitter = scene->sampleLight(its.p, its.shadingFrame.n, lightSample, lightPdf);
+
+            EmitterQueryRecord emitterRecord(its.p, its.shadingFrame.n);
+            Color3f emitterColor(0.0f);
+            float areaPdf = 0.0f;
+            emitterRecord.pdf = 0.0f;
+            if (emitter) {
+                emitterColor = emitter->sample(emitterRecord, samples[0]);
+                areaPdf = emitterRecord.pdf;
+                convertToSolidAngle(emitterRecord);
+            }
+
+            if (emitterRecord.pdf > 0.0f) {
+                BSDFQueryRecord hypotheticalBsdfRecord(its.toLocal(emitterRecord.wi),
+                    its.toLocal(-ray.d), ESolidAngle);
+                float hypoBsdfPdf = bsdf->pdf(hypotheticalBsdfRecord);
+                /* Without a cosine factor: the sampled emitter value already contains both cosines of the geometric term */
+                Color3f hypoBsdfColor = bsdf->eval(hypotheticalBsdfRecord);
+                float emitterPdf = emitterRecord.pdf * lightPdf;
+                float emitterWeight = emitterPdf / (emitterPdf + hypoBsdfPdf);
+
+                /* The emitter returns the radiance times the geometric term, which is sampled by area */
+                Color3f contribution = throughput * emitterColor * hypoBsdfColor * emitterWeight
+                    / (areaPdf * lightPdf);
+                if (contribution.maxCoeff() > 0.0f) {
+                    float distance;
+                    Ray3f ray = shadowRay(scene, emitterRecord, distance);
+                    queue.shadowRays.push_back({ path, ray, distance, contribution });
+                }
+            }
+
+            /* Sample from mesh */
+            BSDFQueryRecord bsdfRecord(its.toLocal(-ray.d));
+            Color3f bsdfColor = bsdf->sample(bsdfRecord, samples[1]);
+            float bsdfPdf = bsdf->pdf(bsdfRecord);
+
+            if (bsdfPdf > 0.0f)
+                queue.emitterRays.push_back({ path, Ray3f(its.p, its.toWorld(bsdfRecord.wo)),
+                                              throughput * bsdfColor, bsdfPdf, its.shadingFrame.n });
+
+            /* Continue the path */
+            BSDFQueryRecord continueRecord(its.toLocal(-ray.d));
+            Color3f continueColor = bsdf->sample(continueRecord, samples[2]);
+
+            queue.throughput[path] *= continueColor / queue.rrProb[path];
+            queue.eta[path] *= continueRecord.eta;
+
+            if (bounce > 3) {
+                float eta = queue.eta[path];
+                queue.rrProb[path] = std::fmin(0.99f, queue.throughput[path].maxCoeff() * eta * eta);
+                if (sampler->next1D() > queue.rrProb[path]) {
+                    Statistics::count(ERussianRouletteTerminations);
+                    Statistics::sample(EPathLength, bounce);
+                    continue;
+                }
+            }
+
+            queue.dimensions[path] = sampler->getDimension();
+            queue.rays[path] = Ray3f(its.p, its.toWorld(continueRecord.wo));
+            queue.active.push_back(path);
+        }
+    }
+
+    void traceShadowRays(const Scene* scene, PathQueue& queue) const {
+        for (const ShadowRay& shadowRay : queue.shadowRays) {
+            if (!scene->occluded(shadowRay.ray, shadowRay.distance))
+                queue.radiance[shadowRay.path] += shadowRay.contribution;
+        }
+    }
+
+    void traceEmitterRays(const Scene* scene, PathQueue& queue) const {
+        Intersection its;
+        for (const EmitterRay& emitterRay : queue.emitterRays) {
+            if (!scene->rayIntersect(emitterRay.ray, its) || !its.mesh->isEmitter())
+                continue;
+
+            Emitter* emitter = scene->getLight(its);
+
+            EmitterQueryRecord emitterRecord(emitterRay.ray.o);
+            emitterRecord.wi = emitterRay.ray.d;
+            emitterRecord.n = its.geoFrame.n;
+            emitterRecord.p = its.p;
+            emitterRecord.pdf = emitter->pdf(emitterRecord);
+
+            convertToSolidAngle(emitterRecord);
+            float emitterPdf = emitterRecord.pdf * scene->pdfLight(emitterRay.ray.o, emitterRay.n, emitter);
+            float bsdfSampleWeight = emitterRay.bsdfPdf / (emitterRay.bsdfPdf + emitterPdf);
+            queue.radiance[emitterRay.path] += emitterRay.weight * emitter->eval(emitterRecord) * bsdfSampleWeight;
+        }
+    }
+
+    int m_queueSize;
+    bool m_sortRays;
+    std::unordered_map<const BSDF*, uint32_t> m_materials;
+};
+
+LUMINA_REGISTER_CLASS(PathWavefrontIntegrator, "path_wavefront")
+LUMINA_NAMESPACE_END
@@ -20,6 +20,7 @@ Color3f AreaLight::sample(EmitterQueryRecord &record, const Point2f &sample) con
 
     float distance = record.oToP.dot(record.oToP);
     float numerator = abs(record.refNormal.dot(record.wi)) * abs(record.n.dot(-record.wi));
+    record.distance = std::sqrt(distance);
 
     if (distance == 0.0f || record.pdf == 0.0f) {
         record.pdf = 0.0f;
@@ -34,8 +34,40 @@ struct EmitterQueryRecord {
     // Pdf of emitter
     float pdf;
 
-    EmitterQueryRecord(Point3f p) : refOrigin(p) {}
-    EmitterQueryRecord(Point3f p, Vector3f n) : refOrigin(p), refNormal(n) {}
+    // Distance from refOrigin to the sampled position (infinite for directional lights)
+    float distance;
+
+    EmitterQueryRecord(Point3f p) : refOrigin(p), refNormal(0.0f, 0.0f, 0.0f), distance(Infinity) {}
+    EmitterQueryRecord(Point3f p, Vector3f n) : refOrigin(p), refNormal(n), distance(Infinity) {}
+};
+
+/**
+ * \brief Conservative bounds of where and in which directions a light emits
+ *
+ * Used by \ref LightSampler to estimate the contribution of a light, or
+ * of a group of lights, to a shading point without sampling it.
+ */
+struct LightBounds {
+    /// Region containing the emitting positions
+    BoundingBox3f bounds;
+    /// Emitted power, as a luminance
+    float phi = 0.0f;
+    /// Axis of the cone containing the surface normals
+    Vector3f w = Vector3f(0.0f, 0.0f, 1.0f);
+    /// Cosine of the half-angle of the cone of normals (-1 for all directions)
+    float cosThetaO = 1.0f;
+    /// Cosine of the angle past the normals up to which light is emitted (0 for diffuse emitters)
+    float cosThetaE = 0.0f;
+
+    /**
+     * \brief Upper bound of the contribution to a point with the given normal, up to a constant
+     *
+     * A zero normal ignores the orientation of the receiver.
+     */
+    float importance(const Point3f& p, const Normal3f& n) const;
+
+    /// Bounds of the union of two lights
+    static LightBounds merge(const LightBounds& a, const LightBounds& b);
 };
 
 class Emitter : public LuminaObject {
@@ -44,16 +76,27 @@ public:
 
     virtual Color3f sample(EmitterQueryRecord& record, const Point2f& sample) const = 0;
     virtual float pdf() const = 0;
+
+    /**
+     * \brief Density with respect to area of \ref sample() choosing \c record.p for \c record.refOrigin
+     *
+     * Defaults to \ref pdf(), for emitters whose density does not depend on the reference point.
+     */
+    virtual float pdf(const EmitterQueryRecord&) const { return pdf(); }
     virtual Color3f eval(const EmitterQueryRecord& record) const = 0;
 
     virtual Color3f getRadiance() const = 0;
+
+    /// Compute the bounds of the emission, returns false for lights without (such as directional lights)
+    virtual bool getLightBounds(LightBounds&) const { return false; }
+
     Mesh* getMesh() { return m_mesh; }
     void setMesh(Mesh* mesh) { m_mesh = mesh; }
 
     EClassType getClassType() const { return EEmitter; }
 
 protected:
-    Mesh* m_mesh;
+    Mesh* m_mesh = nullptr;
     EmitterType m_type;
 };
 
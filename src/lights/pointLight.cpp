@@ -16,6 +16,7 @@ public:
 
         float distance = record.oToP.dot(record.oToP);
         float numerator = abs(record.refNormal.dot(record.wi));
+        record.distance = std::sqrt(distance);
 
         return eval(record) * numerator / (distance * distance);
     }
@@ -37,6 +38,14 @@ public:
     }
     Color3f getRadiance() const { return m_radiance; }
 
+    bool getLightBounds(LightBounds& bounds) const {
+        bounds.bounds = BoundingBox3f(m_position);
+        bounds.phi = 4 * M_PI * m_radiance.getLuminance();
+        bounds.cosThetaO = -1.0f;
+        bounds.cosThetaE = 0.0f;
+        return true;
+    }
+
 private:
     Color3f m_radiance;
     Point3f m_position;
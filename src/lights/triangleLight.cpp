@@ -0,0 +1,156 @@
+//
+// Created by agent on 10/18/26.
+//
+
+#include "triangleLight.h"
+#include "utils/warp.h"
+
+#include <Eigen/Geometry>
+
+LUMINA_NAMESPACE_BEGIN
+
+/* Solid angles (in steradians) between which triangles are sampled by solid angle: below, area
+   sampling is just as good, and above, spherical triangle sampling becomes inaccurate */
+#define MIN_SPHERICAL_SOLID_ANGLE 3e-4f
+#define MAX_SPHERICAL_SOLID_ANGLE 6.22f
+
+TriangleLight::TriangleLight(const Emitter *parent, Mesh *mesh, uint32_t index)
+    : m_radiance(parent->getRadiance()), m_index(index) {
+    m_mesh = mesh;
+    m_type = AREA_LIGHT;
+
+    const ConstMatrixXfMap& vertices = mesh->getVertexPositions();
+    const ConstMatrixXuMap& faces = mesh->getIndices();
+    m_p0 = vertices.col(faces(0, index));
+    m_p1 = vertices.col(faces(1, index));
+    m_p2 = vertices.col(faces(2, index));
+
+    Vector3f cross = (m_p1 - m_p0).cross(m_p2 - m_p0);
+    m_area = 0.5f * cross.norm();
+    m_normal = m_area > 0 ? Normal3f(cross.normalized()) : Normal3f(0.0f, 0.0f, 1.0f);
+}
+
+bool TriangleLight::useSolidAngle(const Point3f &ref, float &solidAnglePdf) const {
+    Vector3f a = (m_p0 - ref).normalized(), b = (m_p1 - ref).normalized(), c = (m_p2 - ref).normalized();
+    solidAnglePdf = Warp::squareToSphericalTrianglePdf(a, b, c);
+    return solidAnglePdf > 1.0f / MAX_SPHERICAL_SOLID_ANGLE && solidAnglePdf < 1.0f / MIN_SPHERICAL_SOLID_ANGLE;
+}
+
+Normal3f TriangleLight::getNormal(const Vector3f &bary) const {
+    const ConstMatrixXfMap& normals = m_mesh->getVertexNormals();
+    if (normals.size() == 0)
+        return m_normal;
+
+    const ConstMatrixXuMap& faces = m_mesh->getIndices();
+    Normal3f n0 = normals.col(faces(0, m_index)), n1 = normals.col(faces(1, m_index)),
+             n2 = normals.col(faces(2, m_index));
+    Normal3f n = n0 * bary.x() + n1 * bary.y() + n2 * bary.z();
+    return n.squaredNorm() > 0 ? Normal3f(n.normalized()) : m_normal;
+}
+
+Color3f TriangleLight::sample(EmitterQueryRecord &record, const Point2f &sample) const {
+    record.pdf = 0.0f;
+    if (m_area == 0.0f)
+        return Color3f(0.0f);
+
+    Vector3f bary;
+    float solidAnglePdf;
+    if (useSolidAngle(record.refOrigin, solidAnglePdf)) {
+        Vector3f wi = Warp::squareToSphericalTriangle(sample, (m_p0 - record.refOrigin).normalized(),
+                                                      (m_p1 - record.refOrigin).normalized(),
+                                                      (m_p2 - record.refOrigin).normalized());
+
+        /* Find the sampled point on the triangle */
+        float cosTheta = m_normal.dot(wi);
+        if (cosTheta == 0.0f)
+            return Color3f(0.0f);
+        float t = m_normal.dot(m_p0 - record.refOrigin) / cosTheta;
+        if (!(t > 0.0f))
+            return Color3f(0.0f);
+        record.p = record.refOrigin + t * wi;
+
+        Vector3f e0 = m_p1 - m_p0, e1 = m_p2 - m_p0, e2 = record.p - m_p0;
+        float d00 = e0.dot(e0), d01 = e0.dot(e1), d11 = e1.dot(e1), d20 = e2.dot(e0), d21 = e2.dot(e1);
+        float denominator = d00 * d11 - d01 * d01;
+        float b1 = std::max((d11 * d20 - d01 * d21) / denominator, 0.0f);
+        float b2 = std::max((d00 * d21 - d01 * d20) / denominator, 0.0f);
+        bary = Vector3f(std::max(1.0f - b1 - b2, 0.0f), b1, b2);
+        record.n = getNormal(bary);
+
+        /* Convert to a density with respect to area, with the normal the integrators convert back with */
+        record.pdf = solidAnglePdf * std::abs(record.n.dot(wi)) / (t * t);
+    } else {
+        bary = Warp::squareToTriangle(sample);
+        record.p = m_p0 * bary.x() + m_p1 * bary.y() + m_p2 * bary.z();
+        record.n = getNormal(bary);
+        record.pdf = 1.0f / m_area;
+    }
+
+    record.oToP = record.p - record.refOrigin;
+    float distance = record.oToP.dot(record.oToP);
+    record.distance = std::sqrt(distance);
+    if (distance == 0.0f || record.pdf == 0.0f) {
+        record.pdf = 0.0f;
+        return Color3f(0.0f);
+    }
+    record.wi = record.oToP / record.distance;
+
+    float numerator = std::abs(record.refNormal.dot(record.wi)) * std::abs(record.n.dot(-record.wi));
+    return eval(record) * numerator / distance;
+}
+
+float TriangleLight::pdf() const {
+    return m_area > 0.0f ? 1.0f / m_area : 0.0f;
+}
+
+float TriangleLight::pdf(const EmitterQueryRecord &record) const {
+    float solidAnglePdf;
+    if (m_area == 0.0f || !useSolidAngle(record.refOrigin, solidAnglePdf))
+        return pdf();
+
+    Vector3f oToP = record.p - record.refOrigin;
+    float distance = oToP.dot(oToP);
+    if (distance == 0.0f)
+        return 0.0f;
+    return solidAnglePdf * std::abs(record.n.dot(oToP)) / (distance * std::sqrt(distance));
+}
+
+Color3f TriangleLight::eval(const EmitterQueryRecord &record) const {
+    if (record.n.dot(-record.wi) >= 0.0f)
+        return m_radiance;
+
+    return Color3f(0.0f);
+}
+
+bool TriangleLight::getLightBounds(LightBounds &bounds) const {
+    bounds.bounds = BoundingBox3f(m_p0);
+    bounds.bounds.expandBy(m_p1);
+    bounds.bounds.expandBy(m_p2);
+    bounds.phi = m_radiance.getLuminance() * m_area * M_PI;
+    bounds.cosThetaE = 0.0f;
+
+    /* Interpolated normals spread the emission over the cone of the vertex normals */
+    const ConstMatrixXfMap& normals = m_mesh->getVertexNormals();
+    if (normals.size() == 0) {
+        bounds.w = m_normal;
+        bounds.cosThetaO = 1.0f;
+        return true;
+    }
+
+    Normal3f n[3] = { getNormal(Vector3f(1, 0, 0)), getNormal(Vector3f(0, 1, 0)), getNormal(Vector3f(0, 0, 1)) };
+    Vector3f sum = n[0] + n[1] + n[2];
+    bounds.w = sum.squaredNorm() > 0 ? Vector3f(sum.normalized()) : Vector3f(m_normal);
+    bounds.cosThetaO = 1.0f;
+    for (const Normal3f& normal : n)
+        bounds.cosThetaO = std::min(bounds.cosThetaO, bounds.w.dot(normal));
+    if (bounds.cosThetaO < 0.0f)
+        bounds.cosThetaO = -1.0f;
+    return true;
+}
+
+std::string TriangleLight::toString() const {
+    return tfm::format("TriangleLight[mesh=\"%s\", index=%i, radiance=%s]",
+                       m_mesh->getName(), m_index, m_radiance.toString());
+}
+
+LUMINA_NAMESPACE_END
@@ -0,0 +1,52 @@
+//
+// Created by agent on 10/18/26.
+//
+
+#pragma once
+
+#include "emitter.h"
+
+LUMINA_NAMESPACE_BEGIN
+
+/**
+ * \brief A single triangle of an emissive mesh
+ *
+ * The scene splits every area light into one of these per triangle so
+ * that the light sampler can choose triangles individually, see
+ * \ref Scene::getLight(). Triangles that cover a large solid angle from
+ * the reference point are sampled uniformly in solid angle, the others
+ * uniformly by area. Either way \ref sample() reports the density with
+ * respect to area, like \ref AreaLight.
+ */
+class TriangleLight : public Emitter {
+public:
+    TriangleLight(const Emitter* parent, Mesh* mesh, uint32_t index);
+
+    Color3f sample(EmitterQueryRecord& record, const Point2f& sample) const;
+
+    float pdf() const;
+    float pdf(const EmitterQueryRecord& record) const;
+
+    Color3f eval(const EmitterQueryRecord& record) const;
+
+    Color3f getRadiance() const { return m_radiance; }
+
+    bool getLightBounds(LightBounds& bounds) const;
+
+    std::string toString() const;
+
+private:
+    /// Should the triangle be sampled by solid angle from \c ref, and if so with which density?
+    bool useSolidAngle(const Point3f& ref, float& solidAnglePdf) const;
+
+    /// Emission normal at barycentric coordinates \c bary, interpolated if the mesh has normals
+    Normal3f getNormal(const Vector3f& bary) const;
+
+    Color3f m_radiance;
+    uint32_t m_index;
+    Point3f m_p0, m_p1, m_p2;
+    Normal3f m_normal;
+    float m_area;
+};
+
+LUMINA_NAMESPACE_END
@@ -3,60 +3,299 @@
 //
 #include <iostream>
 #include <filesystem>
+#include <atomic>
+#include <cstring>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <fstream>
+#include <map>
 #include <tbb/task_scheduler_observer.h>
 #include <tbb/parallel_for.h>
+#include <tbb/task_arena.h>
 
 #include "utils/parser.h"
 #include "scene/scene.h"
 #include "utils/timer.h"
 #include "tbb/blocked_range.h"
 #include "image/gui.h"
+#include "utils/warp.h"
+#include "primitives/binaryMesh.h"
+#include "utils/socket.h"
+#include "utils/resourceCache.h"
+#include "scene/raySort.h"
+#include "utils/stats.h"
 
 using namespace lumina;
 
 static int numThreads = -1;
 static bool useGui = true;
+static bool benchmarkOnly = false;
+static int passSampleCount = 0;
+static double snapshotInterval = 0.0;
+static double timeBudget = 0.0;
+static float targetError = 0.0f;
+static bool adaptiveSampling = false;
+static int renderBlockSize = LUMINA_BLOCK_SIZE;
+static BlockGenerator::EOrder renderBlockOrder = BlockGenerator::ESpiral;
+static bool benchmarkBlocks = false;
+static int coordinatorPort = 0;
+static std::string coordinatorAddress;
+static std::string statsFileName;
 
-static void renderBlock(const Scene* scene, Sampler* sampler, ImageBlock& block) {
+static void renderBlock(const Scene* scene, Sampler* sampler, ImageBlock& block, size_t sampleCount) {
+    block.clear();
+
+    scene->getIntegrator()->renderBlock(scene, sampler, block, sampleCount);
+}
+
+static double traceRays(const Scene* scene, const std::vector<Ray3f>& rays, std::vector<Intersection>& hits,
+                        std::vector<uint8_t>& found, bool anyHit = false) {
+    tbb::task_arena arena(numThreads);
+    Timer timer;
+
+    arena.execute([&] {
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, rays.size()), [&](const tbb::blocked_range<size_t>& range) {
+            for (size_t i = range.begin(); i < range.end(); i++)
+                found[i] = anyHit ? scene->occluded(rays[i], rays[i].maxt)
+                                  : scene->rayIntersect(rays[i], hits[i]);
+        });
+    });
+
+    return timer.elapsed();
+}
+
+static void reportRays(const std::string& name, size_t count, double elapsed) {
+    std::cout << "Traced " << count << " " << name << " rays (took " << timeString(elapsed)
+              << ", " << tfm::format("%.2f", count / (std::max(elapsed, 1.0) * 1000.0)) << " Mrays/s)\n";
+}
+
+/**
+ * \brief Measure raw ray throughput of the acceleration structure
+ *
+ * Traces one camera ray through the center of every pixel, followed by one
+ * cosine-distributed bounce ray from every hit, which is then traced again
+ * as an occlusion query. The bounce rays are then traced once more after
+ * reordering them in batches the size of a \c path_wavefront queue (see
+ * \ref RaySorter), whose cost is reported separately. Ray generation is
+ * not timed. Finally, the scene's sampler draws the values of four paths
+ * of \c path_mis per pixel on a single thread.
+ */
+static void benchmark(Scene* scene) {
     const Camera* camera = scene->getCamera();
-    const Integrator* integrator = scene->getIntegrator();
+    Vector2i outputSize = camera->getOutputSize();
+    size_t pixelCount = (size_t) outputSize.x() * outputSize.y();
 
-    Point2i offset = block.getOffset();
-    Vector2i size = block.getSize();
+    std::vector<Ray3f> rays(pixelCount);
+    std::vector<Intersection> hits(pixelCount);
+    std::vector<uint8_t> found(pixelCount);
 
-    block.clear();
+    for (int y = 0; y < outputSize.y(); y++) {
+        for (int x = 0; x < outputSize.x(); x++) {
+            Point2f pixelSample((float) x + 0.5f, (float) y + 0.5f);
+            camera->sampleRay(rays[y * outputSize.x() + x], pixelSample, Point2f(0.5f));
+        }
+    }
+
+    reportRays("camera", pixelCount, traceRays(scene, rays, hits, found));
+
+    pcg32 random;
+    std::vector<Ray3f> bounceRays;
+    bounceRays.reserve(pixelCount);
+    for (size_t i = 0; i < pixelCount; i++) {
+        if (!found[i])
+            continue;
+
+        Point2f sample(random.nextFloat(), random.nextFloat());
+        Vector3f wo = hits[i].geoFrame.toWorld(Warp::squareToCosineHemisphere(sample));
+        if (wo.dot(rays[i].d) > 0)
+            wo = -wo;
+        bounceRays.emplace_back(hits[i].p, wo);
+    }
+
+    reportRays("bounce", bounceRays.size(), traceRays(scene, bounceRays, hits, found));
+    reportRays("shadow", bounceRays.size(), traceRays(scene, bounceRays, hits, found, true));
 
-    for (int y = 0; y < size.y(); y++) {
-        for (int x = 0; x < size.x(); x++) {
-            for (uint32_t i = 0; i < sampler->getSampleCount(); i++) {
-                Point2f pixelSample = Point2f(
-                        (float) (x + offset.x()),
-                        (float) (y + offset.y())
-                        ) + sampler->next2D();
-                Point2f apertureSample = sampler->next2D();
+    const size_t sortBatchSize = 1 << 14;
+    RaySorter sorter(scene->getBoundingBox());
+    std::vector<Ray3f> batch;
+    Timer sortTimer;
+    for (size_t start = 0; start < bounceRays.size(); start += sortBatchSize) {
+        size_t end = std::min(start + sortBatchSize, bounceRays.size());
+        batch.assign(bounceRays.begin() + start, bounceRays.begin() + end);
+        sorter.sort(batch, [](const Ray3f& ray) -> const Ray3f& { return ray; });
+        std::copy(batch.begin(), batch.end(), bounceRays.begin() + start);
+    }
+    std::cout << "Sorted " << bounceRays.size() << " bounce rays in batches of " << sortBatchSize
+              << " (took " << timeString(sortTimer.elapsed()) << ")\n";
 
-                Ray3f ray;
-                Color3f value = camera->sampleRay(ray, pixelSample, apertureSample);
+    reportRays("sorted bounce", bounceRays.size(), traceRays(scene, bounceRays, hits, found));
+    reportRays("sorted shadow", bounceRays.size(), traceRays(scene, bounceRays, hits, found, true));
 
-                value *= integrator->Li(scene, sampler, ray);
+    /* Camera samples, then per bounce light selection, light, BSDF and continuation samples and Russian roulette */
+    std::unique_ptr<Sampler> sampler(scene->getSampler()->clone());
+    ImageBlock block(Vector2i::Constant(renderBlockSize), nullptr);
+    sampler->prepare(block);
 
-                block.put(pixelSample, value);
+    const int pathsPerPixel = 4, bounces = 6;
+    float checksum = 0.0f;
+    Timer sampleTimer;
+    for (int y = 0; y < outputSize.y(); y++) {
+        for (int x = 0; x < outputSize.x(); x++) {
+            sampler->generate(Point2i(x, y));
+            for (int i = 0; i < pathsPerPixel; i++) {
+                if (i > 0)
+                    sampler->advance();
+
+                Point2f samples[3];
+                sampler->fill2D(samples, 2);
+                checksum += samples[0].x() + samples[1].y();
+                for (int bounce = 0; bounce < bounces; bounce++) {
+                    checksum += sampler->next1D();
+                    sampler->fill2D(samples, 3);
+                    checksum += samples[0].x() + samples[1].y() + samples[2].x() + sampler->next1D();
+                }
             }
         }
     }
+    double sampleTime = sampleTimer.elapsed();
+
+    /* Keep the values from being optimized away */
+    volatile float sink = checksum;
+    (void) sink;
 
+    size_t valueCount = pixelCount * pathsPerPixel * (4 + bounces * 8);
+    std::cout << "Generated " << valueCount << " sample values (took " << timeString(sampleTime)
+              << tfm::format(", %.2f Mvalues/s)\n", valueCount / (std::max(sampleTime, 1.0) * 1000.0));
 }
 
-static void render(Scene* scene, const std::string& filename) {
+/// Convert an OBJ file into the binary mesh format
+static void convertMesh(const std::string& input, const std::string& output) {
+    PropertyList propsList;
+    propsList.setString("filename", input);
+
+    std::unique_ptr<LuminaObject> mesh(LuminaObjectFactory::createInstance("obj", propsList));
+    BinaryMesh::write(*static_cast<Mesh*>(mesh.get()), output);
+}
+
+/// Strip the extension of the scene file to obtain the base name of the output images
+static std::string getOutputName(const std::string& filename) {
+    std::string outputName = filename;
+    size_t lastdot = outputName.find_last_of(".");
+    if (lastdot != std::string::npos)
+        outputName.erase(lastdot, std::string::npos);
+    return outputName;
+}
+
+/// Return the index of the block at the given offset, counting the blocks of the image row by row
+static int getBlockIndex(const Vector2i& outputSize, const Point2i& offset) {
+    int blocksPerRow = (outputSize.x() + renderBlockSize - 1) / renderBlockSize;
+    return (offset.y() / renderBlockSize) * blocksPerRow + offset.x() / renderBlockSize;
+}
+
+/// Time spent by each thread of the arena during a pass (in milliseconds), filled in for the block benchmark
+struct PassStatistics {
+    std::vector<double> renderTime, mergeTime;
+
+    explicit PassStatistics(int threadCount) : renderTime(threadCount, 0.0), mergeTime(threadCount, 0.0) { }
+};
+
+static double elapsedMs(const std::chrono::steady_clock::time_point& start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * \brief Render the blocks of the image once and accumulate them into \c result
+ *
+ * \param firstSample
+ *     Index of the first sample per pixel taken in this pass
+ * \param sampleCount
+ *     Number of samples per pixel taken in this pass
+ * \param activeBlocks
+ *     If given, only the blocks whose entry (see \ref getBlockIndex()) is
+ *     nonzero are rendered
+ * \param stats
+ *     If given, receives the time spent rendering and merging blocks
+ */
+static void renderPass(const Scene* scene, ImageBlock& result, size_t firstSample, size_t sampleCount,
+                       const std::vector<uint8_t>* activeBlocks = nullptr, PassStatistics* stats = nullptr) {
+    const Camera* camera = scene->getCamera();
+    Vector2i outputSize = camera->getOutputSize();
+    BlockGenerator blockGenerator(outputSize, renderBlockSize, renderBlockOrder);
+
+    tbb::blocked_range<int> range(0, blockGenerator.getBlockCount());
+
+    auto map = [&](const tbb::blocked_range<int>& range) {
+        ImageBlock block(Vector2i(renderBlockSize), camera->getReconstructionFilter(), result.isTrackingVariance());
+
+        std::unique_ptr<Sampler> sampler(scene->getSampler()->clone());
+
+        for (int i = range.begin(); i < range.end(); i++) {
+            blockGenerator.next(block);
+
+            if (activeBlocks && !(*activeBlocks)[getBlockIndex(outputSize, block.getOffset())])
+                continue;
+
+            sampler->prepare(block, firstSample);
+
+            if (stats) {
+                int thread = tbb::this_task_arena::current_thread_index();
+                auto start = std::chrono::steady_clock::now();
+                renderBlock(scene, sampler.get(), block, sampleCount);
+                stats->renderTime[thread] += elapsedMs(start);
+
+                start = std::chrono::steady_clock::now();
+                result.put(block);
+                stats->mergeTime[thread] += elapsedMs(start);
+                continue;
+            }
+
+            renderBlock(scene, sampler.get(), block, sampleCount);
+
+            result.put(block);
+        }
+    };
+
+    tbb::parallel_for(range, map);
+}
+
+/// Return the relative error estimate of every block of the image, indexed by \ref getBlockIndex()
+static std::vector<float> getBlockErrors(const ImageBlock& result) {
+    Vector2i size = result.getSize();
+    std::vector<float> errors;
+
+    for (int y = 0; y < size.y(); y += renderBlockSize) {
+        for (int x = 0; x < size.x(); x += renderBlockSize) {
+            Point2i offset(x, y);
+            Vector2i blockSize = (size - offset).cwiseMin(Vector2i::Constant(renderBlockSize));
+            errors.push_back(result.getRelativeError(offset, blockSize));
+        }
+    }
+
+    return errors;
+}
+
+/**
+ * \brief Render a scene and write the result as \c outputName.png and \c outputName.exr
+ *
+ * \param arena
+ *     Threads that render the passes, which can be shared by consecutive renders
+ */
+static void render(Scene* scene, const std::string& outputName, tbb::task_arena& arena) {
     const Camera* camera = scene->getCamera();
     Vector2i outputSize = camera->getOutputSize();
     scene->getIntegrator()->preprocess(scene);
 
-    BlockGenerator blockGenerator(outputSize, LUMINA_BLOCK_SIZE);
+    /* The sample count of the sampler is an upper bound when rendering
+       to a time budget or error target, which are checked between passes */
+    bool adaptiveTermination = timeBudget > 0 || targetError > 0;
 
-    ImageBlock result(outputSize, camera->getReconstructionFilter());
+    ImageBlock result(outputSize, camera->getReconstructionFilter(), adaptiveTermination);
     result.clear();
 
+    std::atomic<bool> stop(false);
+
     LuminaScreen* screen = nullptr;
     if (useGui) {
         nanogui::init();
@@ -64,39 +303,105 @@ static void render(Scene* scene, const std::string& filename) {
     }
 
     std::thread render_thread([&] {
-        tbb::task_arena init(numThreads);
+        size_t sampleCount = scene->getSampler()->getSampleCount();
+        size_t passSize = passSampleCount > 0 ? std::min((size_t) passSampleCount, sampleCount)
+                                              : (adaptiveTermination ? 1 : sampleCount);
+        size_t passCount = (sampleCount + passSize - 1) / passSize;
 
-        std::cout << "Rendering...";
+        std::cout << "Rendering";
+        if (adaptiveSampling)
+            std::cout << " adaptively in passes of " << passSize << " spp";
+        else if (adaptiveTermination)
+            std::cout << " in passes of " << passSize << " spp";
+        else if (passCount > 1)
+            std::cout << " in " << passCount << " passes of " << passSize << " spp";
+        std::cout << "...";
         std::cout.flush();
 
-        Timer timer;
-
-        tbb::blocked_range<int> range(0, blockGenerator.getBlockCount());
+        StatPhase phase(EPhaseRender);
+        Timer timer, snapshotTimer;
+        size_t samplesDone = 0;
+        double passTime = 0.0, totalSamples = 0.0;
+        float error = std::numeric_limits<float>::infinity();
+        std::string reason;
 
-        auto map = [&](const tbb::blocked_range<int>& range) {
-            ImageBlock block(Vector2i(LUMINA_BLOCK_SIZE), camera->getReconstructionFilter());
+        BlockGenerator blockGenerator(outputSize, renderBlockSize, renderBlockOrder);
+        std::vector<uint8_t> activeBlocks(blockGenerator.getBlockCount(), 1);
+        size_t activePixels = (size_t) outputSize.x() * outputSize.y();
 
-            std::unique_ptr<Sampler> sampler(scene->getSampler()->clone());
+        /* Without adaptive sampling every pass covers the whole image, so
+           stopping between passes always leaves an evenly converged result */
+        while (samplesDone < sampleCount && !stop) {
+            size_t passSamples = std::min(passSize, sampleCount - samplesDone);
 
-            for (int i = range.begin(); i < range.end(); i++) {
-                blockGenerator.next(block);
+            /* Don't start a pass that is not expected to finish within the budget */
+            if (timeBudget > 0 && samplesDone > 0 &&
+                timer.elapsed() + passTime * passSamples > timeBudget * 1000.0) {
+                reason = "time budget reached, ";
+                break;
+            }
 
-                sampler->prepare(block);
+            Timer passTimer;
+            arena.execute([&] {
+                renderPass(scene, result, samplesDone, passSamples, adaptiveSampling ? &activeBlocks : nullptr);
+            });
+            passTime = passTimer.elapsed() / passSamples;
+            samplesDone += passSamples;
+            totalSamples += (double) passSamples * activePixels;
 
-                renderBlock(scene, sampler.get(), block);
+            if (adaptiveTermination) {
+                std::vector<float> errors = getBlockErrors(result);
+                error = *std::max_element(errors.begin(), errors.end());
+                if (targetError > 0 && error <= targetError) {
+                    reason = "target error reached, ";
+                    break;
+                }
 
-                result.put(block);
+                /* Later passes only revisit the blocks that are still above the target */
+                if (adaptiveSampling) {
+                    activePixels = 0;
+                    for (int y = 0; y < outputSize.y(); y += renderBlockSize) {
+                        for (int x = 0; x < outputSize.x(); x += renderBlockSize) {
+                            int index = getBlockIndex(outputSize, Point2i(x, y));
+                            activeBlocks[index] = errors[index] > targetError;
+                            if (activeBlocks[index]) {
+                                Vector2i blockSize = (outputSize - Point2i(x, y)).cwiseMin(Vector2i::Constant(renderBlockSize));
+                                activePixels += (size_t) blockSize.x() * blockSize.y();
+                            }
+                        }
+                    }
+                }
             }
-        };
 
-        tbb::parallel_for(range, map);
+            if (snapshotInterval > 0 && samplesDone < sampleCount &&
+                snapshotTimer.elapsed() >= snapshotInterval * 1000.0) {
+                std::cout << "\nSnapshot after " << samplesDone << " spp (" << timer.elapsedString() << "): ";
+                StatPhase writePhase(EPhaseWrite);
+                std::unique_ptr<Bitmap> bitmap(result.toBitmap());
+                bitmap->saveEXR(outputName);
+                snapshotTimer.reset();
+            }
+        }
 
-        std::cout << " done. (took " << timer.elapsedString() << ") \n";
+        double elapsed = timer.elapsed();
+        std::cout << " done. (" << reason << samplesDone << " spp";
+        if (adaptiveSampling)
+            std::cout << tfm::format(" max., %.1f spp avg.", totalSamples / ((double) outputSize.x() * outputSize.y()));
+        std::cout << ", took " << timeString(elapsed);
+        if (adaptiveTermination) {
+            double sampleRate = totalSamples / (std::max(elapsed, 1.0) * 1000.0);
+            std::cout << tfm::format(", %.2f Msamples/s, max. relative error %.4f", sampleRate, error);
+        }
+        std::cout << ") \n";
     });
 
-    if (useGui)
+    if (useGui) {
         nanogui::mainloop(50.0f);
 
+        /* Closing the window ends the render after the current pass */
+        stop = true;
+    }
+
     render_thread.join();
 
     if (useGui) {
@@ -104,22 +409,563 @@ static void render(Scene* scene, const std::string& filename) {
         nanogui::shutdown();
     }
 
+    StatPhase phase(EPhaseWrite);
     std::unique_ptr<Bitmap> bitmap(result.toBitmap());
-    std::string outputName = filename;
-    size_t lastdot = outputName.find_last_of(".");
-    if (lastdot != std::string::npos)
-        outputName.erase(lastdot, std::string::npos);
 
     bitmap->savePNG(outputName);
     bitmap->saveEXR(outputName);
 }
 
+/**
+ * \brief Compare block sizes and orders
+ *
+ * Renders one pass with the sampler's sample count for every combination
+ * and reports the throughput, the time spent per sample inside the
+ * blocks (which grows when consecutive blocks share less cached scene
+ * data), the share of time spent merging blocks into the film, and the
+ * thread utilization (busy time over wall time, i.e. the load balance).
+ */
+static void benchmarkBlockOrders(Scene* scene) {
+    const Camera* camera = scene->getCamera();
+    Vector2i outputSize = camera->getOutputSize();
+    size_t sampleCount = scene->getSampler()->getSampleCount();
+    double samples = (double) sampleCount * outputSize.x() * outputSize.y();
+    scene->getIntegrator()->preprocess(scene);
+
+    tbb::task_arena arena(numThreads);
+    int threadCount = arena.max_concurrency();
+
+    std::cout << tfm::format("Benchmarking blocks at %i spp with %i threads\n", sampleCount, threadCount)
+              << tfm::format("%6s %-9s %7s %10s %13s %9s %11s %11s\n", "size", "order", "blocks", "time",
+                             "Msamples/s", "ns/sample", "merge", "utilization");
+
+    /* The passes read the global block settings, restore them (even on errors) for what runs next */
+    struct SavedBlockSettings {
+        int size = renderBlockSize;
+        BlockGenerator::EOrder order = renderBlockOrder;
+        ~SavedBlockSettings() {
+            renderBlockSize = size;
+            renderBlockOrder = order;
+        }
+    } savedBlockSettings;
+
+    const char* orderNames[] = { "spiral", "scanline", "morton", "hilbert" };
+    for (int size : { 8, 16, 32, 64 }) {
+        for (const char* orderName : orderNames) {
+            renderBlockSize = size;
+            renderBlockOrder = BlockGenerator::parseOrder(orderName);
+
+            ImageBlock result(outputSize, camera->getReconstructionFilter());
+            result.clear();
+            PassStatistics stats(threadCount);
+
+            auto start = std::chrono::steady_clock::now();
+            arena.execute([&] { renderPass(scene, result, 0, sampleCount, nullptr, &stats); });
+            double wallTime = elapsedMs(start);
+
+            double renderTime = 0.0, mergeTime = 0.0;
+            for (int i = 0; i < threadCount; i++) {
+                renderTime += stats.renderTime[i];
+                mergeTime += stats.mergeTime[i];
+            }
+
+            int blockCount = BlockGenerator(outputSize, size).getBlockCount();
+            std::cout << tfm::format("%6i %-9s %7i %10s %13.3f %9.1f %10.2f%% %10.1f%%\n", size, orderName, blockCount,
+                                     timeString(wallTime, true), samples / (wallTime * 1000.0),
+                                     renderTime * 1e6 / samples, 100.0 * mergeTime / (renderTime + mergeTime),
+                                     100.0 * (renderTime + mergeTime) / (wallTime * threadCount));
+        }
+    }
+}
+
+/// Version of the coordinator/worker protocol, both ends must agree on it
+#define LUMINA_PROTOCOL_VERSION 2
+
+/// Seconds that workers get to leave after the last job before their connections are shut down
+#define LUMINA_WORKER_GRACE_PERIOD 5
+
+/// Message types of the coordinator/worker protocol (see \ref coordinate() and \ref work())
+enum EMessage : uint32_t {
+    /// Worker -> coordinator: \ref HelloMessage
+    EHello = 0x4c4d0001,
+    /// Coordinator -> worker: \ref SceneMessage followed by the path of the scene file and the property overrides
+    EScene,
+    /// Worker -> coordinator: number of jobs (uint32_t) the worker wants
+    ERequest,
+    /// Coordinator -> worker: array of \ref RenderJob
+    EJobs,
+    /// Worker -> coordinator: \ref RenderJob followed by the block's pixels, borders included
+    EResult,
+    /// Coordinator -> worker: all jobs are finished
+    EDone
+};
+
+struct HelloMessage {
+    uint32_t version;
+    uint32_t threadCount;
+};
+
+/// Followed by the scene path and the name and value of every override, each terminated by a null character
+struct SceneMessage {
+    uint32_t blockSize;
+    uint32_t overrideCount;
+};
+
+/// Samples [firstSample, firstSample + sampleCount) of one block
+struct RenderJob {
+    uint32_t id;
+    int32_t offset[2];
+    int32_t size[2];
+    uint32_t reserved;
+    uint64_t firstSample;
+    uint64_t sampleCount;
+};
+
+/**
+ * \brief Render a scene on worker processes (see \ref work())
+ *
+ * Every block of every pass (see \ref render()) becomes a job, which
+ * workers fetch in batches and return as image blocks that are merged
+ * into the film. Workers can connect at any time, and the unfinished
+ * jobs of a worker that disconnects are handed out again. Since jobs
+ * are seeded by their block and first sample, the result does not
+ * depend on which worker rendered what. Workers need to be able to open
+ * the scene under the same absolute path, and load it with the same
+ * property overrides (see \ref loadXMLFile()).
+ */
+static void coordinate(Scene* scene, const std::string& filename, const std::map<std::string, std::string>& overrides,
+                       int port) {
+    const Camera* camera = scene->getCamera();
+    Vector2i outputSize = camera->getOutputSize();
+
+    ImageBlock result(outputSize, camera->getReconstructionFilter());
+    result.clear();
+
+    size_t sampleCount = scene->getSampler()->getSampleCount();
+    size_t passSize = passSampleCount > 0 ? std::min((size_t) passSampleCount, sampleCount) : sampleCount;
+
+    std::vector<RenderJob> jobs;
+    ImageBlock block(Vector2i(renderBlockSize), camera->getReconstructionFilter());
+    for (size_t firstSample = 0; firstSample < sampleCount; firstSample += passSize) {
+        BlockGenerator blockGenerator(outputSize, renderBlockSize, renderBlockOrder);
+        while (blockGenerator.next(block)) {
+            RenderJob job = { (uint32_t) jobs.size(), { block.getOffset().x(), block.getOffset().y() },
+                              { block.getSize().x(), block.getSize().y() }, 0,
+                              firstSample, std::min(passSize, sampleCount - firstSample) };
+            jobs.push_back(job);
+        }
+    }
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<uint32_t> pending;
+    std::vector<uint8_t> finished(jobs.size(), 0);
+    size_t remaining = jobs.size(), workerCount = 0;
+    /* Connections that are still being served, shut down once all jobs are done */
+    std::vector<Socket*> open;
+    bool stopping = false;
+    for (const RenderJob& job : jobs)
+        pending.push_back(job.id);
+
+    SceneMessage sceneHeader = { (uint32_t) renderBlockSize, (uint32_t) overrides.size() };
+    std::vector<uint8_t> sceneMessage(sizeof(SceneMessage));
+    memcpy(sceneMessage.data(), &sceneHeader, sizeof(SceneMessage));
+    auto appendString = [&](const std::string& text) {
+        sceneMessage.insert(sceneMessage.end(), text.begin(), text.end());
+        sceneMessage.push_back(0);
+    };
+    appendString(std::filesystem::absolute(filename).string());
+    for (const auto& entry : overrides) {
+        appendString(entry.first);
+        appendString(entry.second);
+    }
+
+    auto serve = [&](std::unique_ptr<Socket> connection) {
+        std::vector<uint32_t> assigned;
+        ImageBlock block(Vector2i(renderBlockSize), camera->getReconstructionFilter());
+        uint32_t type;
+        std::vector<uint8_t> payload;
+        bool counted = false;
+
+        try {
+            if (!connection->receive(type, payload) || type != EHello || payload.size() != sizeof(HelloMessage) ||
+                reinterpret_cast<const HelloMessage*>(payload.data())->version != LUMINA_PROTOCOL_VERSION)
+                throw LuminaException("Incompatible worker");
+            connection->send(EScene, sceneMessage);
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                std::cout << tfm::format("\nWorker %s joined with %i threads (%i connected)", connection->getAddress(),
+                                         reinterpret_cast<const HelloMessage*>(payload.data())->threadCount,
+                                         ++workerCount);
+                std::cout.flush();
+                counted = true;
+            }
+
+            while (connection->receive(type, payload)) {
+                if (type == ERequest && payload.size() == sizeof(uint32_t)) {
+                    uint32_t count = *reinterpret_cast<const uint32_t*>(payload.data());
+                    std::vector<RenderJob> batch;
+                    {
+                        std::unique_lock<std::mutex> lock(mutex);
+                        changed.wait(lock, [&] { return !pending.empty() || remaining == 0; });
+
+                        for (uint32_t i = 0; i < std::max(count, 1u) && !pending.empty(); i++) {
+                            assigned.push_back(pending.front());
+                            batch.push_back(jobs[pending.front()]);
+                            pending.pop_front();
+                        }
+                    }
+
+                    if (batch.empty()) {
+                        connection->send(EDone, nullptr, 0);
+                        break;
+                    }
+                    connection->send(EJobs, batch);
+                } else if (type == EResult && payload.size() >= sizeof(RenderJob)) {
+                    RenderJob job;
+                    memcpy(&job, payload.data(), sizeof(RenderJob));
+
+                    Vector2i size = Vector2i(job.size[0], job.size[1]) + Vector2i::Constant(2 * block.getBorderSize());
+                    if (job.id >= jobs.size() || (size.array() > Vector2i((int) block.cols(), (int) block.rows()).array()).any() ||
+                        payload.size() != sizeof(RenderJob) + sizeof(Color4f) * size.x() * size.y())
+                        throw LuminaException("Invalid result");
+
+                    block.setOffset(Point2i(job.offset[0], job.offset[1]));
+                    block.setSize(Vector2i(job.size[0], job.size[1]));
+                    /* The pixels aren't aligned within the message, so copy their components one by one */
+                    const uint8_t* pixels = payload.data() + sizeof(RenderJob);
+                    for (int y = 0; y < size.y(); y++) {
+                        for (int x = 0; x < size.x(); x++)
+                            memcpy(block.coeffRef(y, x).data(), pixels + sizeof(Color4f) * (y * size.x() + x), sizeof(Color4f));
+                    }
+
+                    /* Different passes of the same block may arrive at the same time, so merge one by one */
+                    std::lock_guard<std::mutex> lock(mutex);
+                    assigned.erase(std::remove(assigned.begin(), assigned.end(), job.id), assigned.end());
+                    if (!finished[job.id]) {
+                        result.put(block);
+                        finished[job.id] = 1;
+                        if (--remaining == 0)
+                            changed.notify_all();
+                    }
+                } else {
+                    throw LuminaException("Unexpected message %i", type);
+                }
+            }
+        } catch (const std::exception& e) {
+            /* Errors are expected once the connection was shut down after the last job */
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!stopping)
+                std::cerr << "\nWorker " << connection->getAddress() << ": " << e.what();
+        }
+
+        /* Hand out whatever the worker did not finish again */
+        std::lock_guard<std::mutex> lock(mutex);
+        open.erase(std::remove(open.begin(), open.end(), connection.get()), open.end());
+        for (auto it = assigned.rbegin(); it != assigned.rend(); ++it) {
+            if (!finished[*it])
+                pending.push_front(*it);
+        }
+        changed.notify_all();
+
+        /* Workers that failed the hello were never counted */
+        if (!counted)
+            return;
+        if (!assigned.empty() || remaining > 0) {
+            std::cout << tfm::format("\nWorker %s left (%i connected)", connection->getAddress(), --workerCount);
+            std::cout.flush();
+        } else {
+            --workerCount;
+        }
+    };
+
+    std::unique_ptr<Socket> listener = Socket::listen(port);
+    std::cout << "Rendering " << jobs.size() << " jobs on workers connecting to port " << port << "...";
+    std::cout.flush();
+
+    Timer timer;
+    std::vector<std::thread> connections;
+    std::thread acceptor([&] {
+        while (true) {
+            std::unique_ptr<Socket> connection;
+            try {
+                connection = listener->accept();
+            } catch (const std::exception&) {
+                break;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                open.push_back(connection.get());
+            }
+            connections.emplace_back(serve, std::move(connection));
+        }
+    });
+
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [&] { return remaining == 0; });
+    }
+
+    listener->shutdown();
+    acceptor.join();
+
+    /* Workers that are done receive no more jobs and leave by themselves, but a hung one would
+       block its thread in receive() forever: shutting the remaining connections down unblocks them */
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait_for(lock, std::chrono::seconds(LUMINA_WORKER_GRACE_PERIOD), [&] { return open.empty(); });
+        stopping = true;
+        for (Socket* connection : open)
+            connection->shutdown();
+    }
+    for (std::thread& connection : connections)
+        connection.join();
+
+    std::cout << "\nRendering done. (took " << timer.elapsedString() << ") \n";
+
+    StatPhase phase(EPhaseWrite);
+    std::unique_ptr<Bitmap> bitmap(result.toBitmap());
+    std::string outputName = getOutputName(filename);
+    bitmap->savePNG(outputName);
+    bitmap->saveEXR(outputName);
+}
+
+/**
+ * \brief Render jobs for a coordinator (see \ref coordinate()) until it has none left
+ *
+ * \param address
+ *     Host name and port of the coordinator, as "host:port"
+ */
+static void work(const std::string& address) {
+    size_t colon = address.find_last_of(':');
+    if (colon == std::string::npos)
+        throw LuminaException("Expected the coordinator address as host:port, got \"%s\"", address);
+
+    std::unique_ptr<Socket> connection = Socket::connect(address.substr(0, colon), toInt(address.substr(colon + 1)));
+    tbb::task_arena arena(numThreads);
+
+    HelloMessage hello = { LUMINA_PROTOCOL_VERSION, (uint32_t) arena.max_concurrency() };
+    connection->send(EHello, &hello, sizeof(hello));
+
+    uint32_t type;
+    std::vector<uint8_t> payload;
+    if (!connection->receive(type, payload) || type != EScene || payload.size() < sizeof(SceneMessage))
+        throw LuminaException("Unexpected reply from the coordinator at %s", address);
+
+    SceneMessage sceneHeader;
+    memcpy(&sceneHeader, payload.data(), sizeof(SceneMessage));
+
+    size_t position = sizeof(SceneMessage);
+    auto readString = [&]() {
+        auto end = std::find(payload.begin() + position, payload.end(), (uint8_t) 0);
+        if (end == payload.end())
+            throw LuminaException("Malformed scene message from the coordinator at %s", address);
+        std::string text(payload.begin() + position, end);
+        position = end - payload.begin() + 1;
+        return text;
+    };
+
+    std::string sceneFileName = readString();
+    std::map<std::string, std::string> overrides;
+    for (uint32_t i = 0; i < sceneHeader.overrideCount; i++) {
+        std::string name = readString();
+        overrides[name] = readString();
+    }
+
+    getFileResolver()->prepend(std::filesystem::path(sceneFileName).parent_path());
+    std::unique_ptr<LuminaObject> root(loadXMLFile(sceneFileName, overrides));
+    if (root->getClassType() != LuminaObject::EScene)
+        throw LuminaException("\"%s\" does not contain a scene", sceneFileName);
+
+    Scene* scene = static_cast<Scene*>(root.get());
+    const Camera* camera = scene->getCamera();
+    scene->getIntegrator()->preprocess(scene);
+
+    std::cout << "Rendering jobs from " << connection->getAddress() << "...";
+    std::cout.flush();
+
+    Timer timer;
+    size_t jobCount = 0;
+    uint32_t batchSize = 2 * (uint32_t) arena.max_concurrency();
+
+    while (true) {
+        connection->send(ERequest, &batchSize, sizeof(batchSize));
+        if (!connection->receive(type, payload) || type == EDone)
+            break;
+        if (type != EJobs || payload.size() % sizeof(RenderJob) != 0)
+            throw LuminaException("Unexpected message %i from the coordinator", type);
+
+        std::vector<RenderJob> jobs(payload.size() / sizeof(RenderJob));
+        memcpy(jobs.data(), payload.data(), payload.size());
+        std::vector<std::vector<uint8_t>> results(jobs.size());
+
+        arena.execute([&] {
+            tbb::parallel_for(size_t(0), jobs.size(), [&](size_t i) {
+                const RenderJob& job = jobs[i];
+                ImageBlock block(Vector2i((int) sceneHeader.blockSize), camera->getReconstructionFilter());
+                block.setOffset(Point2i(job.offset[0], job.offset[1]));
+                block.setSize(Vector2i(job.size[0], job.size[1]));
+
+                std::unique_ptr<Sampler> sampler(scene->getSampler()->clone());
+                sampler->prepare(block, job.firstSample);
+                renderBlock(scene, sampler.get(), block, job.sampleCount);
+
+                Vector2i size = block.getSize() + Vector2i::Constant(2 * block.getBorderSize());
+                results[i].resize(sizeof(RenderJob) + sizeof(Color4f) * size.x() * size.y());
+                memcpy(results[i].data(), &job, sizeof(RenderJob));
+                for (int y = 0; y < size.y(); y++)
+                    memcpy(results[i].data() + sizeof(RenderJob) + sizeof(Color4f) * y * size.x(), &block.coeff(y, 0),
+                           sizeof(Color4f) * size.x());
+            });
+        });
+
+        for (const std::vector<uint8_t>& result : results)
+            connection->send(EResult, result);
+        jobCount += jobs.size();
+    }
+
+    std::cout << " done. (" << jobCount << " jobs, took " << timer.elapsedString() << ") \n";
+}
+
+/// Scene of a batch job and the property overrides to load it with (see \ref loadXMLFile())
+struct BatchJob {
+    std::string filename;
+    std::map<std::string, std::string> overrides;
+};
+
+/// Parse a "name=value" property override
+static void parseOverride(const std::string& text, std::map<std::string, std::string>& overrides) {
+    size_t equals = text.find('=');
+    if (equals == 0 || equals == std::string::npos)
+        throw LuminaException("Expected a property override as name=value, got \"%s\"", text);
+    overrides[text.substr(0, equals)] = text.substr(equals + 1);
+}
+
+/**
+ * \brief Read the jobs of a batch file
+ *
+ * Every line is a job consisting of a scene file (relative to the batch
+ * file) followed by any number of "name=value" property overrides. Empty
+ * lines and lines starting with '#' are skipped.
+ */
+static std::vector<BatchJob> readBatchFile(const std::string& filename) {
+    std::ifstream is(filename);
+    if (!is)
+        throw LuminaException("Unable to open the batch file \"%s\"", filename);
+
+    std::vector<BatchJob> jobs;
+    std::string line;
+    for (int lineNumber = 1; std::getline(is, line); lineNumber++) {
+        std::vector<std::string> tokens = tokenize(line, " \t\r");
+        if (tokens.empty() || tokens[0][0] == '#')
+            continue;
+
+        BatchJob job;
+        std::filesystem::path scene(tokens[0]);
+        job.filename = (scene.is_relative() ? std::filesystem::path(filename).parent_path() / scene : scene).string();
+
+        try {
+            for (size_t i = 1; i < tokens.size(); i++)
+                parseOverride(tokens[i], job.overrides);
+        } catch (const LuminaException& e) {
+            throw LuminaException("%s (line %i of \"%s\")", e.what(), lineNumber, filename);
+        }
+        jobs.push_back(std::move(job));
+    }
+
+    return jobs;
+}
+
+/**
+ * \brief Render several scenes back to back without a GUI
+ *
+ * Job \c i is written to "<scene>_<i>.png/.exr" next to its scene file.
+ * The jobs share one task arena, and meshes and acceleration structures
+ * that the next job uses again are kept loaded (see \ref ResourceCache).
+ * A job that fails is reported and skipped.
+ *
+ * \return The number of jobs that failed
+ */
+static int renderBatch(const std::vector<BatchJob>& jobs) {
+    useGui = false;
+    tbb::task_arena arena(numThreads);
+    getResourceCache()->setEnabled(true);
+
+    Timer timer;
+    int failed = 0;
+
+    for (size_t i = 0; i < jobs.size(); i++) {
+        std::string filename = jobs[i].filename;
+        std::cout << "Job " << i + 1 << "/" << jobs.size() << ": " << filename;
+        for (const auto& entry : jobs[i].overrides)
+            std::cout << " " << entry.first << "=" << entry.second;
+        std::cout << std::endl;
+
+        /* Files referenced by the scene are looked up next to it first */
+        getFileResolver()->prepend(std::filesystem::path(filename).parent_path());
+
+        try {
+            std::unique_ptr<LuminaObject> root(loadXMLFile(filename, jobs[i].overrides));
+
+            /* Keep exactly what this job uses loaded, for the next job */
+            getResourceCache()->trim();
+
+            if (root->getClassType() != LuminaObject::EScene)
+                throw LuminaException("\"%s\" does not contain a scene", filename);
+
+            render(static_cast<Scene*>(root.get()), tfm::format("%s_%04i", getOutputName(filename), i), arena);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << "\n";
+            failed++;
+        }
+
+        getFileResolver()->erase(getFileResolver()->begin());
+    }
+
+    getResourceCache()->setEnabled(false);
+
+    std::cout << "Batch done. (" << jobs.size() << " jobs";
+    if (failed > 0)
+        std::cout << ", " << failed << " failed";
+    std::cout << ", took " << timer.elapsedString() << ")" << std::endl;
+    return failed;
+}
+
+/// Write the statistics of the run if --stats was given, returns false on failure
+static bool writeStatistics() {
+    if (statsFileName.empty())
+        return true;
+
+    try {
+        Statistics::writeJSON(statsFileName);
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return false;
+    }
+    std::cout << "Statistics written to \"" << statsFileName << "\"" << std::endl;
+    return true;
+}
+
 int main(int argc, char** argv) {
     if (argc < 2) {
-        std::cout << "Syntax: " << argv[0] << " <scene.xml> [--no-gui] [--threads N]\n";
+        std::cout << "Syntax: " << argv[0] << " <scene.xml> [--no-gui] [--threads N] [--benchmark]\n"
+                  << "       " << std::string(strlen(argv[0]), ' ')
+                  << " [--progressive SPP] [--snapshot SECONDS] [--time-budget SECONDS] [--target-error E]\n"
+                  << "       " << std::string(strlen(argv[0]), ' ') << " [--adaptive]\n"
+                  << "       " << std::string(strlen(argv[0]), ' ')
+                  << " [--block-size N] [--block-order spiral|scanline|morton|hilbert] [--benchmark-blocks]\n"
+                  << "       " << std::string(strlen(argv[0]), ' ') << " [--coordinator PORT] [--set NAME=VALUE] [--stats FILE]\n"
+                  << "       " << argv[0] << " --batch <jobs.txt> | <scene.xml> <scene.xml>... [--set NAME=VALUE] [--threads N]\n"
+                  << "       " << std::string(strlen(argv[0]), ' ') << " [--stats FILE]\n"
+                  << "       " << argv[0] << " --worker <host:port> [--threads N]\n"
+                  << "       " << argv[0] << " --convert <mesh.obj> <mesh.lmesh>\n";
     }
 
-    std::string sceneFileName = "";
+    std::vector<BatchJob> jobs;
+    std::map<std::string, std::string> overrides;
+    bool batch = false;
 
     for (int i = 0; i < argc; i++) {
         std::string token(argv[i]);
@@ -141,15 +987,142 @@ int main(int argc, char** argv) {
         } else if (token == "--no-gui") {
             useGui = false;
             continue;
+        } else if (token == "--progressive") {
+            if (i+1 >= argc || (passSampleCount = atoi(argv[i+1])) <= 0) {
+                std::cerr << "--progressive expected a positive number of samples per pixel per pass \n";
+                return -1;
+            }
+            i++;
+            continue;
+        } else if (token == "--snapshot") {
+            if (i+1 >= argc || (snapshotInterval = atof(argv[i+1])) <= 0) {
+                std::cerr << "--snapshot expected a positive number of seconds between snapshots \n";
+                return -1;
+            }
+            i++;
+            continue;
+        } else if (token == "--time-budget") {
+            if (i+1 >= argc || (timeBudget = atof(argv[i+1])) <= 0) {
+                std::cerr << "--time-budget expected a positive number of seconds \n";
+                return -1;
+            }
+            i++;
+            continue;
+        } else if (token == "--target-error") {
+            if (i+1 >= argc || (targetError = (float) atof(argv[i+1])) <= 0) {
+                std::cerr << "--target-error expected a positive relative error \n";
+                return -1;
+            }
+            i++;
+            continue;
+        } else if (token == "--adaptive") {
+            adaptiveSampling = true;
+            continue;
+        } else if (token == "--block-size") {
+            if (i+1 >= argc || (renderBlockSize = atoi(argv[i+1])) <= 0) {
+                std::cerr << "--block-size expected a positive number of pixels \n";
+                return -1;
+            }
+            i++;
+            continue;
+        } else if (token == "--block-order") {
+            if (i+1 >= argc) {
+                std::cerr << "--block-order expected spiral, scanline, morton or hilbert \n";
+                return -1;
+            }
+
+            try {
+                renderBlockOrder = BlockGenerator::parseOrder(argv[i+1]);
+            } catch (const std::exception& e) {
+                std::cerr << "Error: " << e.what() << "\n";
+                return -1;
+            }
+            i++;
+            continue;
+        } else if (token == "--benchmark-blocks") {
+            benchmarkBlocks = true;
+            continue;
+        } else if (token == "--coordinator") {
+            if (i+1 >= argc || (coordinatorPort = atoi(argv[i+1])) <= 0) {
+                std::cerr << "--coordinator expected the port to listen on \n";
+                return -1;
+            }
+            i++;
+            continue;
+        } else if (token == "--worker") {
+            if (i+1 >= argc) {
+                std::cerr << "--worker expected the address of the coordinator as host:port \n";
+                return -1;
+            }
+            coordinatorAddress = argv[i+1];
+            i++;
+            continue;
+        } else if (token == "--batch") {
+            if (i+1 >= argc) {
+                std::cerr << "--batch expected a file listing the jobs \n";
+                return -1;
+            }
+
+            try {
+                std::vector<BatchJob> batchJobs = readBatchFile(argv[i+1]);
+                jobs.insert(jobs.end(), batchJobs.begin(), batchJobs.end());
+            } catch (const std::exception& e) {
+                std::cerr << "Error: " << e.what() << "\n";
+                return -1;
+            }
+            batch = true;
+            i++;
+            continue;
+        } else if (token == "--set") {
+            if (i+1 >= argc) {
+                std::cerr << "--set expected a property override as name=value \n";
+                return -1;
+            }
+
+            try {
+                parseOverride(argv[i+1], overrides);
+            } catch (const std::exception& e) {
+                std::cerr << "Error: " << e.what() << "\n";
+                return -1;
+            }
+            i++;
+            continue;
+        } else if (token == "--stats") {
+            if (i+1 >= argc) {
+                std::cerr << "--stats expected the file to write the statistics to \n";
+                return -1;
+            }
+#if !defined(LUMINA_HAS_STATS)
+            std::cerr << "--stats is not available, statistics were disabled at compile time \n";
+            return -1;
+#endif
+            statsFileName = argv[i+1];
+            i++;
+            continue;
+        } else if (token == "--benchmark") {
+            benchmarkOnly = true;
+            continue;
+        } else if (token == "--convert") {
+            if (i+2 >= argc) {
+                std::cerr << "--convert expected an input .obj file and an output file \n";
+                return -1;
+            }
+
+            try {
+                convertMesh(argv[i+1], argv[i+2]);
+            } catch (const std::exception& e) {
+                std::cerr << "Error: " << e.what() << "\n";
+                return -1;
+            }
+            i += 2;
+            continue;
         }
 
         std::filesystem::path path(argv[i]);
 
         try {
             if (path.extension() == ".xml") {
-                sceneFileName = argv[i];
-
-                getFileResolver()->prepend(path.parent_path());
+                jobs.push_back({ argv[i], {} });
             } else {
                 std::cerr << "Error: unknown file format " << argv[i]
                 << ", expected file format .xml \n";
@@ -160,20 +1133,73 @@ int main(int argc, char** argv) {
         }
     }
 
-    if (sceneFileName != "") {
-        if (numThreads < 0) {
-            numThreads = tbb::info::default_concurrency();
+    if (adaptiveSampling && targetError <= 0) {
+        std::cerr << "--adaptive requires --target-error \n";
+        return -1;
+    }
+
+    /* The coordinator hands out fixed jobs, it neither stops early nor writes snapshots */
+    if (coordinatorPort > 0 && (adaptiveSampling || timeBudget > 0 || targetError > 0 || snapshotInterval > 0)) {
+        std::cerr << "--coordinator does not support --adaptive, --time-budget, --target-error and --snapshot \n";
+        return -1;
+    }
+
+    if (numThreads < 0) {
+        numThreads = tbb::info::default_concurrency();
+    }
+
+    if (!coordinatorAddress.empty()) {
+        try {
+            work(coordinatorAddress);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << "\n";
+            return -1;
+        }
+        return 0;
+    }
+
+    /* Overrides of the command line apply to every job, those of a batch file take precedence */
+    for (BatchJob& job : jobs)
+        job.overrides.insert(overrides.begin(), overrides.end());
+
+    if (batch || jobs.size() > 1) {
+        if (benchmarkOnly || benchmarkBlocks || coordinatorPort > 0) {
+            std::cerr << "--benchmark, --benchmark-blocks and --coordinator take a single scene \n";
+            return -1;
         }
 
+        int failed = renderBatch(jobs);
+        if (!writeStatistics())
+            return -1;
+        return failed > 0 ? -1 : 0;
+    }
+
+    if (!jobs.empty()) {
+        std::string sceneFileName = jobs[0].filename;
+        getFileResolver()->prepend(std::filesystem::path(sceneFileName).parent_path());
+
         try {
-            std::unique_ptr<LuminaObject> root(loadXMLFile(sceneFileName));
+            std::unique_ptr<LuminaObject> root(loadXMLFile(sceneFileName, jobs[0].overrides));
 
-            if (root->getClassType() == LuminaObject::EScene)
-                render(static_cast<Scene*>(root.get()), sceneFileName);
+            if (root->getClassType() == LuminaObject::EScene) {
+                if (benchmarkOnly)
+                    benchmark(static_cast<Scene*>(root.get()));
+                else if (benchmarkBlocks)
+                    benchmarkBlockOrders(static_cast<Scene*>(root.get()));
+                else if (coordinatorPort > 0)
+                    coordinate(static_cast<Scene*>(root.get()), sceneFileName, jobs[0].overrides, coordinatorPort);
+                else {
+                    tbb::task_arena arena(numThreads);
+                    render(static_cast<Scene*>(root.get()), getOutputName(sceneFileName), arena);
+                }
+            }
         } catch (const std::exception& e) {
             std::cerr << e.what() << "\n";
             return -1;
         }
+
+        if (!writeStatistics())
+            return -1;
     }
     return 0;
 }
@@ -0,0 +1,118 @@
+//
+// Created by agent on 10/17/26.
+//
+
+#pragma once
+
+#include "bbox.h"
+
+#if defined(LUMINA_HAS_SSE)
+#include <immintrin.h>
+#endif
+
+LUMINA_NAMESPACE_BEGIN
+
+/**
+ * \brief Four axis-aligned bounding boxes in structure-of-arrays form
+ *
+ * Used by wide BVH nodes so that all children can be culled with a single
+ * slab test (see \ref intersectBoundingBox4()).
+ */
+struct alignas(16) BoundingBox4 {
+    float min[3][4];
+    float max[3][4];
+
+    BoundingBox4() {
+        for (int lane = 0; lane < 4; lane++)
+            set(lane, BoundingBox3f(Point3f(0.0f)));
+    }
+
+    /// Store a box in the given lane
+    void set(int lane, const BoundingBox3f &box) {
+        for (int i = 0; i < 3; i++) {
+            min[i][lane] = box.min[i];
+            max[i][lane] = box.max[i];
+        }
+    }
+};
+
+/// Ray origin and reciprocal direction broadcast to all lanes
+struct BoundingBox4Ray {
+#if defined(LUMINA_HAS_SSE)
+    __m128 o[3], dRcp[3];
+#else
+    float o[3], dRcp[3];
+#endif
+    /// Whether the ray travels towards negative coordinates, i.e. enters the slabs through \c max
+    bool negative[3];
+
+    explicit BoundingBox4Ray(const Ray3f &ray) {
+        for (int i = 0; i < 3; i++) {
+#if defined(LUMINA_HAS_SSE)
+            o[i] = _mm_set1_ps(ray.o[i]);
+            dRcp[i] = _mm_set1_ps(ray.dRcp[i]);
+#else
+            o[i] = ray.o[i];
+            dRcp[i] = ray.dRcp[i];
+#endif
+            negative[i] = std::signbit(ray.dRcp[i]);
+        }
+    }
+};
+
+/**
+ * \brief Slab test of a ray segment against all four boxes
+ *
+ * The entry and exit planes of every slab are chosen from the sign of the
+ * direction, so no min/max between the two distances is needed. A zero
+ * direction component with the origin on a box face gives 0 * inf = NaN,
+ * and such a distance leaves \c tNear or \c tFar unchanged: the test never
+ * culls a box that \ref BoundingBox3f::rayIntersect() would accept.
+ *
+ * \param nearT
+ *     Receives the entry distance (clamped to \c mint) of every lane
+ * \return Bit mask of the lanes whose box overlaps [mint, maxt]
+ */
+inline int intersectBoundingBox4(const BoundingBox4 &box, const BoundingBox4Ray &ray,
+                                 float mint, float maxt, float nearT[4]) {
+#if defined(LUMINA_HAS_SSE)
+    __m128 tNear = _mm_set1_ps(mint), tFar = _mm_set1_ps(maxt);
+
+    for (int i = 0; i < 3; i++) {
+        const float* entry = ray.negative[i] ? box.max[i] : box.min[i];
+        const float* exit = ray.negative[i] ? box.min[i] : box.max[i];
+        __m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(entry), ray.o[i]), ray.dRcp[i]);
+        __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(exit), ray.o[i]), ray.dRcp[i]);
+
+        /* min/max return the second operand if either one is NaN, which keeps the current bound */
+        tNear = _mm_max_ps(t0, tNear);
+        tFar = _mm_min_ps(t1, tFar);
+    }
+
+    _mm_storeu_ps(nearT, tNear);
+    return _mm_movemask_ps(_mm_cmple_ps(tNear, tFar));
+#else
+    int mask = 0;
+    for (int lane = 0; lane < 4; lane++) {
+        float tNear = mint, tFar = maxt;
+
+        for (int i = 0; i < 3; i++) {
+            float entry = ray.negative[i] ? box.max[i][lane] : box.min[i][lane];
+            float exit = ray.negative[i] ? box.min[i][lane] : box.max[i][lane];
+            float t0 = (entry - ray.o[i]) * ray.dRcp[i];
+            float t1 = (exit - ray.o[i]) * ray.dRcp[i];
+
+            /* Comparisons with NaN are false, which keeps the current bound */
+            tNear = t0 > tNear ? t0 : tNear;
+            tFar = t1 < tFar ? t1 : tFar;
+        }
+
+        nearT[lane] = tNear;
+        if (tNear <= tFar)
+            mask |= 1 << lane;
+    }
+    return mask;
+#endif
+}
+
+LUMINA_NAMESPACE_END
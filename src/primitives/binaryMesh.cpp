@@ -0,0 +1,176 @@
+//
+// Created by agent on 10/17/26.
+//
+
+#include "binaryMesh.h"
+#include "utils/timer.h"
+#include "utils/stats.h"
+
+#include <fstream>
+
+LUMINA_NAMESPACE_BEGIN
+
+/// Header of a binary mesh file, followed by the arrays referenced by \c offsets
+struct BinaryMeshHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t vertexCount;
+    uint32_t faceCount;
+    uint32_t flags;
+    float bboxMin[3];
+    float bboxMax[3];
+    /// Total surface area, the stored distribution is normalized by it
+    float areaSum;
+    uint32_t padding;
+    /// Positions, normals, texture coordinates, indices, area CDF (0 if absent)
+    uint64_t offsets[5];
+};
+
+enum EBinaryMeshFlags {
+    EHasNormals = 1,
+    EHasTexCoords = 2
+};
+
+static const char BINARY_MESH_MAGIC[8] = { 'L', 'U', 'M', 'M', 'E', 'S', 'H', 0 };
+static constexpr uint32_t BINARY_MESH_VERSION = 1;
+/// Arrays start at multiples of this (mapped memory is page aligned)
+static constexpr uint64_t BINARY_MESH_ALIGNMENT = 64;
+
+BinaryMesh::BinaryMesh(const PropertyList &propsList) {
+    StatPhase phase(EPhaseMeshLoad);
+    std::filesystem::path filename =
+            getFileResolver()->resolve(propsList.getString("filename"));
+    Transform transform = propsList.getTransform("toWorld", Transform());
+
+    std::cout << "Loading " << filename << "...";
+    std::cout.flush();
+    Timer timer;
+
+    m_file = std::make_unique<MappedFile>(filename.string());
+
+    BinaryMeshHeader header;
+    if (m_file->size() < sizeof(BinaryMeshHeader))
+        throw LuminaException("\"%s\" is not a binary mesh file", filename);
+    memcpy(&header, m_file->data(), sizeof(BinaryMeshHeader));
+
+    if (memcmp(header.magic, BINARY_MESH_MAGIC, sizeof(BINARY_MESH_MAGIC)) != 0)
+        throw LuminaException("\"%s\" is not a binary mesh file", filename);
+    if (header.version != BINARY_MESH_VERSION)
+        throw LuminaException("\"%s\" has version %i, expected %i (convert it again)",
+                              filename, header.version, BINARY_MESH_VERSION);
+
+    bool hasNormals = (header.flags & EHasNormals) != 0;
+    bool hasTexCoords = (header.flags & EHasTexCoords) != 0;
+    const uint64_t sizes[5] = {
+        3ull * header.vertexCount * sizeof(float),
+        hasNormals ? 3ull * header.vertexCount * sizeof(float) : 0,
+        hasTexCoords ? 2ull * header.vertexCount * sizeof(float) : 0,
+        3ull * header.faceCount * sizeof(uint32_t),
+        (header.faceCount + 1ull) * sizeof(float)
+    };
+    for (int i = 0; i < 5; i++) {
+        if (header.offsets[i] % BINARY_MESH_ALIGNMENT != 0 || header.offsets[i] + sizes[i] > m_file->size())
+            throw LuminaException("\"%s\" is truncated or corrupt", filename);
+    }
+
+    const float *vertices = m_file->at<float>(header.offsets[0]);
+    const float *normals = hasNormals ? m_file->at<float>(header.offsets[1]) : nullptr;
+    const float *uvs = hasTexCoords ? m_file->at<float>(header.offsets[2]) : nullptr;
+    const uint32_t *faces = m_file->at<uint32_t>(header.offsets[3]);
+
+    if (transform.getMatrix() == Eigen::Matrix4f::Identity()) {
+        setBuffers(vertices, normals, uvs, faces, header.vertexCount, header.faceCount);
+        m_bbox = BoundingBox3f(Point3f(header.bboxMin[0], header.bboxMin[1], header.bboxMin[2]),
+                               Point3f(header.bboxMax[0], header.bboxMax[1], header.bboxMax[2]));
+        m_pdf.setNormalized(m_file->at<float>(header.offsets[4]), header.faceCount, header.areaSum);
+    } else {
+        /* Transformed meshes need their own copy, the area distribution is recomputed in activate() */
+        m_vertexData.resize(3, header.vertexCount);
+        for (uint32_t i = 0; i < header.vertexCount; i++) {
+            Point3f p = transform * Point3f(vertices[3 * i], vertices[3 * i + 1], vertices[3 * i + 2]);
+            m_vertexData.col(i) = p;
+            m_bbox.expandBy(p);
+        }
+
+        if (normals) {
+            m_normalData.resize(3, header.vertexCount);
+            for (uint32_t i = 0; i < header.vertexCount; i++)
+                m_normalData.col(i) = (transform * Normal3f(normals[3 * i], normals[3 * i + 1], normals[3 * i + 2])).normalized();
+        }
+
+        if (uvs)
+            m_uvData = ConstMatrixXfMap(uvs, 2, header.vertexCount);
+        m_faceData = ConstMatrixXuMap(faces, 3, header.faceCount);
+        useOwnedBuffers();
+    }
+
+    m_name = filename.string();
+    std::cout << "done. (V=" << m_vertices.cols() << ", F=" << m_faces.cols() << ", took "
+              << timer.elapsedString() << " and " << memString(m_file->size()) << " mapped)" << std::endl;
+}
+
+void BinaryMesh::write(const Mesh &mesh, const std::string &filename) {
+    std::cout << "Writing \"" << filename << "\"...";
+    std::cout.flush();
+    Timer timer;
+
+    const ConstMatrixXfMap &V = mesh.getVertexPositions();
+    const ConstMatrixXfMap &N = mesh.getVertexNormals();
+    const ConstMatrixXfMap &UV = mesh.getVertexTexCoords();
+    const ConstMatrixXuMap &F = mesh.getIndices();
+
+    DiscretePDF pdf(mesh.getTriangleCount());
+    for (uint32_t i = 0; i < mesh.getTriangleCount(); i++)
+        pdf.append(mesh.surfaceArea(i));
+
+    BinaryMeshHeader header;
+    memset(&header, 0, sizeof(BinaryMeshHeader));
+    memcpy(header.magic, BINARY_MESH_MAGIC, sizeof(BINARY_MESH_MAGIC));
+    header.version = BINARY_MESH_VERSION;
+    header.vertexCount = mesh.getVertexCount();
+    header.faceCount = mesh.getTriangleCount();
+    header.flags = (N.size() > 0 ? EHasNormals : 0) | (UV.size() > 0 ? EHasTexCoords : 0);
+    for (int i = 0; i < 3; i++) {
+        header.bboxMin[i] = mesh.getBoundingBox().min[i];
+        header.bboxMax[i] = mesh.getBoundingBox().max[i];
+    }
+    header.areaSum = pdf.normalize();
+
+    const char *arrays[5] = {
+        (const char *) V.data(), (const char *) N.data(), (const char *) UV.data(),
+        (const char *) F.data(), (const char *) pdf.getCDF()
+    };
+    const uint64_t sizes[5] = {
+        V.size() * sizeof(float), N.size() * sizeof(float), UV.size() * sizeof(float),
+        F.size() * sizeof(uint32_t), (pdf.size() + 1) * sizeof(float)
+    };
+
+    uint64_t offset = sizeof(BinaryMeshHeader);
+    for (int i = 0; i < 5; i++) {
+        offset = (offset + BINARY_MESH_ALIGNMENT - 1) / BINARY_MESH_ALIGNMENT * BINARY_MESH_ALIGNMENT;
+        header.offsets[i] = offset;
+        offset += sizes[i];
+    }
+
+    std::ofstream os(filename, std::ios::binary | std::ios::trunc);
+    if (!os)
+        throw LuminaException("Unable to open \"%s\" for writing", filename);
+
+    const char padding[BINARY_MESH_ALIGNMENT] = {};
+    os.write((const char *) &header, sizeof(BinaryMeshHeader));
+    uint64_t position = sizeof(BinaryMeshHeader);
+    for (int i = 0; i < 5; i++) {
+        os.write(padding, (std::streamsize) (header.offsets[i] - position));
+        os.write(arrays[i], (std::streamsize) sizes[i]);
+        position = header.offsets[i] + sizes[i];
+    }
+
+    if (!os)
+        throw LuminaException("Unable to write \"%s\"", filename);
+
+    std::cout << "done. (V=" << header.vertexCount << ", F=" << header.faceCount << ", took "
+              << timer.elapsedString() << " and " << memString(position) << ")" << std::endl;
+}
+
+LUMINA_REGISTER_CLASS(BinaryMesh, "binary")
+LUMINA_NAMESPACE_END
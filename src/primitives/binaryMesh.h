@@ -0,0 +1,32 @@
+//
+// Created by agent on 10/17/26.
+//
+
+#pragma once
+
+#include "mesh.h"
+#include "utils/mappedFile.h"
+
+LUMINA_NAMESPACE_BEGIN
+
+/**
+ * \brief Mesh stored in Lumina's binary mesh format (see \ref BinaryMesh::write())
+ *
+ * The file holds the vertex positions, normals, texture coordinates,
+ * triangle indices, bounds and the normalized area distribution in the
+ * layout used by \ref Mesh. It is memory-mapped and, unless a \c toWorld
+ * transform is given, all buffers are used in place without any parsing
+ * or copying.
+ */
+class BinaryMesh : public Mesh {
+public:
+    BinaryMesh(const PropertyList& propsList);
+
+    /// Write a loaded mesh (e.g. a \ref WavefrontObj) to the given file
+    static void write(const Mesh& mesh, const std::string& filename);
+
+private:
+    std::unique_ptr<MappedFile> m_file;
+};
+
+LUMINA_NAMESPACE_END
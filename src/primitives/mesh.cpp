@@ -21,7 +21,13 @@ void Mesh::activate() {
             LuminaObjectFactory::createInstance("diffuse", PropertyList())
             );
     }
+
+    /* Binary meshes may come with a precomputed distribution */
+    if (m_pdf.size() == getTriangleCount() && m_pdf.isNormalized())
+        return;
+
     uint32_t triangleCount = getTriangleCount();
+    m_pdf.clear();
     m_pdf.reserve(triangleCount);
     for (uint32_t i = 0; i < triangleCount; i++) {
         m_pdf.append(surfaceArea(i));
@@ -29,6 +35,22 @@ void Mesh::activate() {
     m_pdf.normalize();
 }
 
+void Mesh::setBuffers(const float *vertices, const float *normals, const float *uvs,
+                      const uint32_t *faces, uint32_t vertexCount, uint32_t faceCount) {
+    /* Eigen::Map can only be re-targeted by constructing it again */
+    new (&m_vertices) ConstMatrixXfMap(vertices, 3, vertexCount);
+    new (&m_normals) ConstMatrixXfMap(normals, 3, normals ? vertexCount : 0);
+    new (&m_uvs) ConstMatrixXfMap(uvs, 2, uvs ? vertexCount : 0);
+    new (&m_faces) ConstMatrixXuMap(faces, 3, faceCount);
+}
+
+void Mesh::useOwnedBuffers() {
+    setBuffers(m_vertexData.data(),
+               m_normalData.size() > 0 ? m_normalData.data() : nullptr,
+               m_uvData.size() > 0 ? m_uvData.data() : nullptr,
+               m_faceData.data(), (uint32_t) m_vertexData.cols(), (uint32_t) m_faceData.cols());
+}
+
 float Mesh::surfaceArea(uint32_t index) const {
     uint32_t i0 = m_faces(0, index), i1 = m_faces(1, index), i2 = m_faces(2, index);
 
@@ -128,13 +150,15 @@ std::string Mesh::toString() const {
 }
 
     void Mesh::samplePosition(const Point2f &sample, Point3f &p, Normal3f &n) const {
-        uint32_t index = m_pdf.sample(sample[0]);
+        /* Pick the triangle with the first coordinate, then stretch it back over [0, 1] for the position */
+        float sampleX = sample.x();
+        uint32_t index = (uint32_t) m_pdf.sampleReuse(sampleX);
 
         uint32_t i0 = m_faces(0, index), i1 = m_faces(1, index),
                 i2 = m_faces(2, index);
         Point3f p0 = m_vertices.col(i0), p1 = m_vertices.col(i1), p2 = m_vertices.col(i2);
 
-        Vector3f baryCoords = Warp::squareToTriangle(sample);
+        Vector3f baryCoords = Warp::squareToTriangle(Point2f(std::min(sampleX, 1.0f), sample.y()));
 
         p = p0 * baryCoords.x() + p1 * baryCoords.y() + p2 * baryCoords.z();
 
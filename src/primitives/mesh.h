@@ -28,8 +28,10 @@ struct Intersection {
     Frame geoFrame;
     /// Pointer to associated mesh
     const Mesh* mesh;
+    /// Index of the intersected triangle within the mesh
+    uint32_t triangle;
 
-    Intersection() : mesh(nullptr) {}
+    Intersection() : mesh(nullptr), triangle(0) {}
 
     Vector3f toLocal(const Vector3f& d) const {
         return shadingFrame.toLocal(d);
@@ -72,16 +74,19 @@ public:
     float pdf() const;
 
     /// Return a pointer to the vertex positions
-    const MatrixXf &getVertexPositions() const { return m_vertices; }
+    const ConstMatrixXfMap &getVertexPositions() const { return m_vertices; }
 
     /// Return a pointer to the vertex normals (or \c nullptr if there are none)
-    const MatrixXf &getVertexNormals() const { return m_normals; }
+    const ConstMatrixXfMap &getVertexNormals() const { return m_normals; }
 
     /// Return a pointer to the texture coordinates (or \c nullptr if there are none)
-    const MatrixXf &getVertexTexCoords() const { return m_uvs; }
+    const ConstMatrixXfMap &getVertexTexCoords() const { return m_uvs; }
 
     /// Return a pointer to the triangle vertex index list
-    const MatrixXu &getIndices() const { return m_faces; }
+    const ConstMatrixXuMap &getIndices() const { return m_faces; }
+
+    /// Return the distribution used to sample triangles proportional to their area
+    const DiscretePDF &getAreaDistribution() const { return m_pdf; }
 
     /// Is this mesh an area emitter?
     bool isEmitter() const { return m_emitter != nullptr; }
@@ -113,11 +118,30 @@ public:
 protected:
     Mesh();
 
+    /**
+     * \brief Point the buffer views at external memory
+     *
+     * The memory has to stay valid for the lifetime of the mesh. Normals
+     * and texture coordinates may be \c nullptr.
+     */
+    void setBuffers(const float *vertices, const float *normals, const float *uvs,
+                    const uint32_t *faces, uint32_t vertexCount, uint32_t faceCount);
+
+    /// Point the buffer views at the owned \c m_*Data matrices (after filling them)
+    void useOwnedBuffers();
+
     std::string m_name;
-    MatrixXf m_vertices;
-    MatrixXf m_normals;
-    MatrixXf m_uvs;
-    MatrixXu m_faces;
+    /* Owned storage, empty for meshes that reference external memory */
+    MatrixXf m_vertexData;
+    MatrixXf m_normalData;
+    MatrixXf m_uvData;
+    MatrixXu m_faceData;
+
+    /* Views used by all accessors */
+    ConstMatrixXfMap m_vertices { nullptr, 3, 0 };
+    ConstMatrixXfMap m_normals { nullptr, 3, 0 };
+    ConstMatrixXfMap m_uvs { nullptr, 2, 0 };
+    ConstMatrixXuMap m_faces { nullptr, 3, 0 };
 
     BSDF* m_bsdf = nullptr;
     Emitter* m_emitter = nullptr;
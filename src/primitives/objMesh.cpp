@@ -2,117 +2,335 @@
 // Created by juperez on 5/25/23.
 //
 
-#include <fstream>
-#include <sstream>
+#include <charconv>
+#include <unordered_map>
+#include <tbb/parallel_for.h>
+#include <tbb/blocked_range.h>
 #include "objMesh.h"
 #include "utils/timer.h"
+#include "utils/mappedFile.h"
+#include "utils/resourceCache.h"
+#include "utils/stats.h"
 
 LUMINA_NAMESPACE_BEGIN
 
-WavefrontObj::WavefrontObj(const lumina::PropertyList &propsList) {
-    typedef std::unordered_map<OBJVertex, uint32_t, OBJVertexHash> VertexMap;
+/* Locale-independent parsing helpers, 'it' is advanced past what was consumed */
+namespace {
+    inline void skipSpaces(const char *&it, const char *end) {
+        while (it != end && (*it == ' ' || *it == '\t'))
+            it++;
+    }
+
+    inline const char *findLineEnd(const char *it, const char *end) {
+        const char *newline = (const char *) memchr(it, '\n', end - it);
+        return newline ? newline : end;
+    }
+
+    /// Start of the line after the one ending at \c lineEnd (\c end for the last line)
+    inline const char *nextLine(const char *lineEnd, const char *end) {
+        return lineEnd == end ? end : lineEnd + 1;
+    }
+
+    /// Trim the leading spaces and the trailing '\r' of files with Windows line endings
+    inline void trimLine(const char *&it, const char *&lineEnd) {
+        if (lineEnd != it && lineEnd[-1] == '\r')
+            lineEnd--;
+        skipSpaces(it, lineEnd);
+    }
+
+    enum EOBJLine {
+        EOtherLine,
+        EPositionLine,
+        ETexCoordLine,
+        ENormalLine,
+        EFaceLine
+    };
 
+    /// Kind of a trimmed line, shared by both passes so that they always agree on the counts
+    inline EOBJLine classifyLine(const char *it, const char *end) {
+        if (end - it < 2)
+            return EOtherLine;
+        bool space = it[1] == ' ' || it[1] == '\t';
+        if (it[0] == 'v')
+            return space ? EPositionLine : it[1] == 't' ? ETexCoordLine : it[1] == 'n' ? ENormalLine : EOtherLine;
+        return it[0] == 'f' && space ? EFaceLine : EOtherLine;
+    }
+
+    inline float parseFloat(const char *&it, const char *end) {
+        skipSpaces(it, end);
+        if (it != end && *it == '+')
+            it++;
+
+        float value = 0.0f;
+        std::from_chars_result result = std::from_chars(it, end, value);
+        if (result.ec != std::errc())
+            throw LuminaException("Invalid number \"%s\"", std::string(it, findLineEnd(it, end)));
+        it = result.ptr;
+        return value;
+    }
+
+    inline int64_t parseIndex(const char *&it, const char *end) {
+        bool negative = false;
+        if (it != end && (*it == '-' || *it == '+'))
+            negative = *it++ == '-';
+
+        int64_t value = 0;
+        const char *start = it;
+        while (it != end && *it >= '0' && *it <= '9')
+            value = value * 10 + (*it++ - '0');
+        if (it == start)
+            throw LuminaException("Invalid vertex index \"%s\"", std::string(start, findLineEnd(start, end)));
+
+        return negative ? -value : value;
+    }
+
+    /// Turn a 1-based or negative (relative) OBJ index into a 0-based one
+    inline uint32_t resolveIndex(int64_t index, uint32_t countSoFar, uint32_t total, const char *type) {
+        int64_t resolved = index > 0 ? index - 1 : (int64_t) countSoFar + index;
+        if (index == 0 || resolved < 0 || resolved >= total)
+            throw LuminaException("OBJ %s index %i is out of range (%i available)", type, index, total);
+        return (uint32_t) resolved;
+    }
+}
+
+WavefrontObj::WavefrontObj(const lumina::PropertyList &propsList) {
     std::filesystem::path filename =
             getFileResolver()->resolve(propsList.getString("filename"));
+    Transform transform = propsList.getTransform("toWorld", Transform());
+
+    /* The same file is only parsed again if it changed or is placed differently */
+    std::error_code error;
+    auto modified = std::filesystem::last_write_time(filename, error).time_since_epoch().count();
+    std::string key = tfm::format("obj:%s:%i:%i", std::filesystem::absolute(filename).string(), (int64_t) modified,
+                                  hashBytes(transform.getMatrix().data(), sizeof(Eigen::Matrix4f)));
+
+    m_data = getResourceCache()->find<OBJData>(key);
+    if (m_data) {
+        std::cout << "Reusing " << filename << " (V=" << m_data->vertices.cols() << ", F="
+                  << m_data->faces.cols() << ")" << std::endl;
+    } else {
+        m_data = load(filename, transform);
+        getResourceCache()->insert(key, m_data);
+    }
+
+    setBuffers(m_data->vertices.data(),
+               m_data->normals.size() > 0 ? m_data->normals.data() : nullptr,
+               m_data->uvs.size() > 0 ? m_data->uvs.data() : nullptr,
+               m_data->faces.data(), (uint32_t) m_data->vertices.cols(), (uint32_t) m_data->faces.cols());
+    m_bbox = m_data->bbox;
+    m_name = filename.string();
+}
 
-    std::ifstream is(filename.string());
-    if (is.fail())
+std::shared_ptr<const WavefrontObj::OBJData> WavefrontObj::load(const std::filesystem::path &filename,
+                                                                const Transform &transform) {
+    StatPhase phase(EPhaseMeshLoad);
+    typedef std::unordered_map<OBJVertex, uint32_t, OBJVertexHash> VertexMap;
+
+    std::unique_ptr<MappedFile> file;
+    try {
+        file = std::make_unique<MappedFile>(filename.string());
+    } catch (const std::exception &) {
         throw LuminaException("Unable to open OBJ file %s!", filename);
-    Transform transform = propsList.getTransform("toWorld", Transform());
+    }
 
     std::cout << "Loading " << filename << "...";
     std::cout.flush();
     Timer timer;
 
-    std::vector<Vector3f> positions;
-    std::vector<Vector3f> normals;
-    std::vector<Vector2f> texCoords;
-    std::vector<uint32_t> indices;
+    auto obj = std::make_shared<OBJData>();
+
+    /* Split the file into chunks that end at line boundaries */
+    std::vector<OBJChunk> chunks;
+    const char *data = (const char *) file->data(), *dataEnd = data + file->size();
+    for (const char *it = data; it < dataEnd; ) {
+        OBJChunk chunk;
+        chunk.begin = it;
+        chunk.end = it + std::min<size_t>(LUMINA_OBJ_CHUNK_SIZE, dataEnd - it);
+        if (chunk.end != dataEnd)
+            chunk.end = nextLine(findLineEnd(chunk.end, dataEnd), dataEnd);
+        it = chunk.end;
+        chunks.push_back(std::move(chunk));
+    }
+
+    /* First pass: count the attributes of every chunk, so that indices
+       (including relative ones) can be resolved while parsing in parallel */
+    tbb::parallel_for(size_t(0), chunks.size(), [&](size_t i) { countChunk(chunks[i]); });
+
+    uint32_t positionCount = 0, texCoordCount = 0, normalCount = 0;
+    for (OBJChunk &chunk : chunks) {
+        chunk.positionBase = positionCount;
+        chunk.texCoordBase = texCoordCount;
+        chunk.normalBase = normalCount;
+        positionCount += chunk.positionCount;
+        texCoordCount += chunk.texCoordCount;
+        normalCount += chunk.normalCount;
+    }
+
+    std::vector<Point3f> positions(positionCount);
+    std::vector<Point2f> texCoords(texCoordCount);
+    std::vector<Normal3f> normals(normalCount);
+
+    /* Second pass: parse, deduplicating face vertices within each chunk */
+    try {
+        tbb::parallel_for(size_t(0), chunks.size(), [&](size_t i) {
+            parseChunk(chunks[i], transform, positions, texCoords, normals);
+        });
+    } catch (const LuminaException &e) {
+        throw LuminaException("Unable to parse OBJ file %s: %s", filename, e.what());
+    }
+
+    /* Merge the per-chunk vertex tables in file order, which assigns the
+       same indices as deduplicating the whole file sequentially */
     std::vector<OBJVertex> vertices;
+    std::vector<std::vector<uint32_t>> remaps(chunks.size());
+    std::vector<size_t> indexOffsets(chunks.size() + 1, 0);
     VertexMap vertexMap;
+    for (size_t i = 0; i < chunks.size(); i++) {
+        remaps[i].resize(chunks[i].vertices.size());
+        for (size_t j = 0; j < chunks[i].vertices.size(); j++) {
+            auto result = vertexMap.emplace(chunks[i].vertices[j], (uint32_t) vertices.size());
+            if (result.second)
+                vertices.push_back(chunks[i].vertices[j]);
+            remaps[i][j] = result.first->second;
+        }
+        indexOffsets[i + 1] = indexOffsets[i] + chunks[i].indices.size();
+        obj->bbox.expandBy(chunks[i].bbox);
+    }
 
-    std::string line_str;
-    while (std::getline(is, line_str)) {
-        std::istringstream line(line_str);
+    obj->faces.resize(3, indexOffsets.back() / 3);
+    tbb::parallel_for(size_t(0), chunks.size(), [&](size_t i) {
+        uint32_t *faces = obj->faces.data() + indexOffsets[i];
+        for (size_t j = 0; j < chunks[i].indices.size(); j++)
+            faces[j] = remaps[i][chunks[i].indices[j]];
+    });
 
-        std::string prefix;
-        line >> prefix;
+    bool hasNormals = !normals.empty(), hasTexCoords = !texCoords.empty();
+    obj->vertices.resize(3, vertices.size());
+    if (hasNormals)
+        obj->normals.resize(3, vertices.size());
+    if (hasTexCoords)
+        obj->uvs.resize(2, vertices.size());
 
-        if (prefix == "v") {
-            Point3f p;
-            line >> p.x() >> p.y() >> p.z();
-            p = transform * p;
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, vertices.size()), [&](const tbb::blocked_range<size_t> &range) {
+        for (size_t i = range.begin(); i != range.end(); i++) {
+            const OBJVertex &v = vertices[i];
+            obj->vertices.col(i) = positions[v.p];
 
-            m_bbox.expandBy(p);
-            positions.push_back(p);
-        } else if (prefix == "vt") {
-            Point2f tc;
-            line >> tc.x() >> tc.y();
-            texCoords.push_back(tc);
-        } else if (prefix == "vn") {
-            Normal3f n;
-            line >> n.x() >> n.y() >> n.z();
-
-            normals.push_back((transform * n).normalized());
-        } else if (prefix == "f") {
-            std::string v1, v2, v3, v4;
-            line >> v1 >> v2 >> v3 >> v4;
-            OBJVertex verts[6];
-            int nVertices = 3;
-
-            verts[0] = OBJVertex(v1);
-            verts[1] = OBJVertex(v2);
-            verts[2] = OBJVertex(v3);
-
-            if (!v4.empty()) {
-                verts[3] = OBJVertex(v4);
-                verts[4] = verts[0];
-                verts[5] = verts[2];
-                nVertices = 6;
+            if (hasNormals) {
+                if (v.n == (uint32_t) -1)
+                    throw LuminaException("OBJ face vertex without a normal in a mesh with normals");
+                obj->normals.col(i) = normals[v.n];
             }
 
-            for (int i =0; i < nVertices; i++) {
-                const OBJVertex& v = verts[i];
-                auto it = vertexMap.find(v);
-                if (it == vertexMap.end()) {
-                    vertexMap[v] = (uint32_t) vertices.size();
-                    indices.push_back((uint32_t) vertices.size());
-                    vertices.push_back(v);
-                } else {
-                    indices.push_back(it->second);
-                }
+            if (hasTexCoords) {
+                if (v.uv == (uint32_t) -1)
+                    throw LuminaException("OBJ face vertex without texture coordinates in a mesh with texture coordinates");
+                obj->uvs.col(i) = texCoords[v.uv];
             }
         }
-    }
+    });
 
-    m_faces.resize(3, indices.size()/3);
-    memcpy(m_faces.data(), indices.data(), sizeof(uint32_t) * indices.size());
+    std::cout << "done. (V=" << obj->vertices.cols() << ", F=" << obj->faces.cols() << ", took "
+              << timer.elapsedString() << " and "
+              << memString(obj->faces.size() * sizeof(uint32_t) +
+                           sizeof(float) * (obj->vertices.size() + obj->normals.size() + obj->uvs.size()))
+              << ", peak " << memString(getPeakMemoryUsage()) << ")" << std::endl;
+    return obj;
+}
 
-    m_vertices.resize(3, vertices.size());
-    for (uint32_t i = 0; i < vertices.size(); i++) {
-        m_vertices.col(i) = positions.at(vertices[i].p - 1);
-    }
+void WavefrontObj::countChunk(OBJChunk &chunk) {
+    for (const char *it = chunk.begin; it < chunk.end; ) {
+        const char *lineEnd = findLineEnd(it, chunk.end), *next = nextLine(lineEnd, chunk.end);
+        trimLine(it, lineEnd);
 
-    if (!normals.empty()) {
-        m_normals.resize(3, vertices.size());
-        for (uint32_t i=0; i<vertices.size(); ++i) {
-            m_normals.col(i) = normals.at(vertices[i].n-1);
+        switch (classifyLine(it, lineEnd)) {
+            case EPositionLine: chunk.positionCount++; break;
+            case ETexCoordLine: chunk.texCoordCount++; break;
+            case ENormalLine: chunk.normalCount++; break;
+            default: break;
         }
+
+        it = next;
     }
+}
+
+void WavefrontObj::parseChunk(OBJChunk &chunk, const Transform &transform, std::vector<Point3f> &positions,
+                              std::vector<Point2f> &texCoords, std::vector<Normal3f> &normals) {
+    typedef std::unordered_map<OBJVertex, uint32_t, OBJVertexHash> VertexMap;
 
-    if (!texCoords.empty()) {
-        m_uvs.resize(2, vertices.size());
-        for (uint32_t i = 0; i < vertices.size(); i++) {
-            m_uvs.col(i) = texCoords.at(vertices[i].uv - 1);
+    VertexMap vertexMap;
+    uint32_t positionIndex = chunk.positionBase, texCoordIndex = chunk.texCoordBase, normalIndex = chunk.normalBase;
+    std::vector<uint32_t> polygon;
+
+    for (const char *it = chunk.begin; it < chunk.end; ) {
+        const char *end = findLineEnd(it, chunk.end), *next = nextLine(end, chunk.end);
+        trimLine(it, end);
+        EOBJLine type = classifyLine(it, end);
+
+        if (type == EPositionLine) {
+            it += 1;
+            Point3f p;
+            p.x() = parseFloat(it, end);
+            p.y() = parseFloat(it, end);
+            p.z() = parseFloat(it, end);
+            p = transform * p;
+
+            chunk.bbox.expandBy(p);
+            positions[positionIndex++] = p;
+        } else if (type == ETexCoordLine) {
+            it += 2;
+            Point2f tc;
+            tc.x() = parseFloat(it, end);
+            /* The second coordinate is optional */
+            skipSpaces(it, end);
+            tc.y() = it != end ? parseFloat(it, end) : 0.0f;
+            texCoords[texCoordIndex++] = tc;
+        } else if (type == ENormalLine) {
+            it += 2;
+            Normal3f n;
+            n.x() = parseFloat(it, end);
+            n.y() = parseFloat(it, end);
+            n.z() = parseFloat(it, end);
+            normals[normalIndex++] = (transform * n).normalized();
+        } else if (type == EFaceLine) {
+            it += 1;
+            polygon.clear();
+
+            while (true) {
+                skipSpaces(it, end);
+                if (it == end)
+                    break;
+
+                /* p, p/uv, p//n or p/uv/n */
+                OBJVertex v;
+                v.p = resolveIndex(parseIndex(it, end), positionIndex, (uint32_t) positions.size(), "position");
+                if (it != end && *it == '/') {
+                    it++;
+                    if (it != end && *it != '/')
+                        v.uv = resolveIndex(parseIndex(it, end), texCoordIndex, (uint32_t) texCoords.size(), "texture coordinate");
+                    if (it != end && *it == '/') {
+                        it++;
+                        v.n = resolveIndex(parseIndex(it, end), normalIndex, (uint32_t) normals.size(), "normal");
+                    }
+                }
+
+                auto result = vertexMap.emplace(v, (uint32_t) chunk.vertices.size());
+                if (result.second)
+                    chunk.vertices.push_back(v);
+                polygon.push_back(result.first->second);
+            }
+
+            if (polygon.size() < 3)
+                throw LuminaException("OBJ face with %i vertices", polygon.size());
+
+            /* Triangulate as a fan: (0, 1, 2), then (k, 0, k - 1) which keeps the winding */
+            chunk.indices.insert(chunk.indices.end(), { polygon[0], polygon[1], polygon[2] });
+            for (size_t k = 3; k < polygon.size(); k++)
+                chunk.indices.insert(chunk.indices.end(), { polygon[k], polygon[0], polygon[k - 1] });
         }
-    }
 
-    m_name = filename.string();
-    std::cout << "done. (V=" << m_vertices.cols() << ", F=" << m_faces.cols() << ", took "
-              << timer.elapsedString() << " and "
-              << memString(m_faces.size() * sizeof(uint32_t) +
-                           sizeof(float) * (m_vertices.size() + m_normals.size() + m_uvs.size()))
-              << ")" << std::endl;
+        it = next;
+    }
 }
 
 LUMINA_REGISTER_CLASS(WavefrontObj, "obj")
@@ -8,32 +8,39 @@
 
 LUMINA_NAMESPACE_BEGIN
 
+/// Size of the pieces an OBJ file is split into for parallel parsing
+#define LUMINA_OBJ_CHUNK_SIZE (4 * 1024 * 1024)
+
+/**
+ * \brief Wavefront OBJ mesh loader
+ *
+ * The file is split into chunks at line boundaries that are parsed in
+ * parallel. Polygons with any number of vertices are triangulated as
+ * fans, and negative (relative) indices are supported. Meshes loading
+ * the same unchanged file with the same transform share the parsed
+ * buffers while the \ref ResourceCache is enabled.
+ */
 class WavefrontObj : public Mesh {
 public:
     WavefrontObj(const PropertyList& propsList);
 
 protected:
+    /// Parsed and transformed contents of an OBJ file
+    struct OBJData {
+        MatrixXf vertices, normals, uvs;
+        MatrixXu faces;
+        BoundingBox3f bbox;
+    };
+
+    /// Parse an OBJ file, placing it in the world with the given transform
+    static std::shared_ptr<const OBJData> load(const std::filesystem::path& filename, const Transform& transform);
+
+    /// Resolved, zero-based attribute indices of a face vertex (-1 if absent)
     struct OBJVertex {
         uint32_t p = (uint32_t) -1;
         uint32_t n = (uint32_t) -1;
         uint32_t uv = (uint32_t) -1;
 
-        inline OBJVertex() {}
-
-        inline  OBJVertex(const std::string& string) {
-            std::vector<std::string> tokens = tokenize(string, "/", true);
-
-            if (tokens.size() < 1 || tokens.size() > 3)
-                throw LuminaException("Invalid vertex data: %s", string);
-
-            p = toUInt(tokens[0]);
-            if (tokens.size() >= 2 && !tokens[1].empty())
-                uv = toUInt(tokens[1]);
-
-            if (tokens.size() >= 3 && !tokens[2].empty())
-                n = toUInt(tokens[2]);
-        }
-
         inline bool operator==(const OBJVertex &v) const {
             return v.p == p && v.n == n && v.uv == uv;
         }
@@ -48,6 +55,29 @@ protected:
             return hash;
         }
     };
+
+    /// Part of the file that is parsed by a single task
+    struct OBJChunk {
+        const char *begin = nullptr, *end = nullptr;
+
+        /* Number of 'v', 'vt' and 'vn' lines, and the number of them in all previous chunks */
+        uint32_t positionCount = 0, texCoordCount = 0, normalCount = 0;
+        uint32_t positionBase = 0, texCoordBase = 0, normalBase = 0;
+
+        /* Unique face vertices in order of first use, and triangles indexing them */
+        std::vector<OBJVertex> vertices;
+        std::vector<uint32_t> indices;
+        BoundingBox3f bbox;
+    };
+
+    /// Count the attribute lines of a chunk
+    static void countChunk(OBJChunk& chunk);
+
+    /// Parse the attributes of a chunk into the global arrays and its faces into the chunk
+    static void parseChunk(OBJChunk& chunk, const Transform& transform, std::vector<Point3f>& positions,
+                           std::vector<Point2f>& texCoords, std::vector<Normal3f>& normals);
+
+    std::shared_ptr<const OBJData> m_data;
 };
 
 LUMINA_NAMESPACE_END
@@ -38,6 +38,9 @@ template <typename PointType, typename VectorType> struct TRay {
             : o(ray.o), d(ray.d), dRcp(ray.dRcp),
               mint(ray.mint), maxt(ray.maxt) { }
 
+    /// Copy assignment (declared, as it is deprecated next to a user-provided copy constructor)
+    TRay &operator=(const TRay &ray) = default;
+
     /// Copy a ray, but change the covered segment of the copy
     TRay(const TRay &ray, Scalar mint, Scalar maxt)
             : o(ray.o), d(ray.d), dRcp(ray.dRcp), mint(mint), maxt(maxt) { }
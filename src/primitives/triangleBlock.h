@@ -0,0 +1,173 @@
+//
+// Created by agent on 10/17/26.
+//
+
+#pragma once
+
+#include "ray.h"
+
+#if defined(LUMINA_HAS_SSE)
+#include <immintrin.h>
+#endif
+
+/// Number of triangles stored (and intersected) together in a \ref TriangleBlock
+#define LUMINA_TRIANGLE_BLOCK_WIDTH 4
+
+LUMINA_NAMESPACE_BEGIN
+
+/**
+ * \brief Structure-of-arrays storage for a small group of triangles
+ *
+ * Each triangle is stored as its first vertex and the two edge vectors
+ * leaving it, which are exactly the quantities used by the Möller–Trumbore
+ * test. Lanes that do not hold a triangle are zeroed and can never be hit.
+ */
+struct alignas(16) TriangleBlock {
+    float p0[3][LUMINA_TRIANGLE_BLOCK_WIDTH];
+    float edge1[3][LUMINA_TRIANGLE_BLOCK_WIDTH];
+    float edge2[3][LUMINA_TRIANGLE_BLOCK_WIDTH];
+
+    TriangleBlock() {
+        for (int lane = 0; lane < LUMINA_TRIANGLE_BLOCK_WIDTH; lane++)
+            setTriangle(lane, Point3f(0.0f), Point3f(0.0f), Point3f(0.0f));
+    }
+
+    /// Store a triangle in the given lane
+    void setTriangle(int lane, const Point3f &v0, const Point3f &v1, const Point3f &v2) {
+        Vector3f e1 = v1 - v0, e2 = v2 - v0;
+        for (int i = 0; i < 3; i++) {
+            p0[i][lane] = v0[i];
+            edge1[i][lane] = e1[i];
+            edge2[i][lane] = e2[i];
+        }
+    }
+};
+
+/// Ray data broadcast to all lanes, set up once per traversal
+struct TriangleBlockRay {
+#if defined(LUMINA_HAS_SSE)
+    __m128 o[3], d[3];
+
+    explicit TriangleBlockRay(const Ray3f &ray) {
+        for (int i = 0; i < 3; i++) {
+            o[i] = _mm_set1_ps(ray.o[i]);
+            d[i] = _mm_set1_ps(ray.d[i]);
+        }
+    }
+#else
+    float o[3], d[3];
+
+    explicit TriangleBlockRay(const Ray3f &ray) {
+        for (int i = 0; i < 3; i++) {
+            o[i] = ray.o[i];
+            d[i] = ray.d[i];
+        }
+    }
+#endif
+};
+
+/**
+ * \brief Intersect a ray with every triangle of a block
+ *
+ * Performs the same arithmetic as \ref Mesh::rayIntersect() for each lane,
+ * including the association order of Eigen's dot products, so both give
+ * identical results.
+ *
+ * \return The lane of the closest hit with mint <= t < maxt (ties go to
+ *         the lowest lane), or -1 if no triangle was hit
+ */
+inline int intersectTriangleBlock(const TriangleBlock &block, const TriangleBlockRay &ray,
+                                  float mint, float maxt, float &u, float &v, float &t) {
+    float us[LUMINA_TRIANGLE_BLOCK_WIDTH], vs[LUMINA_TRIANGLE_BLOCK_WIDTH], ts[LUMINA_TRIANGLE_BLOCK_WIDTH];
+    int mask = 0;
+
+#if defined(LUMINA_HAS_SSE)
+    __m128 e1x = _mm_load_ps(block.edge1[0]), e1y = _mm_load_ps(block.edge1[1]), e1z = _mm_load_ps(block.edge1[2]);
+    __m128 e2x = _mm_load_ps(block.edge2[0]), e2y = _mm_load_ps(block.edge2[1]), e2z = _mm_load_ps(block.edge2[2]);
+
+    /* pvec = d x edge2 */
+    __m128 px = _mm_sub_ps(_mm_mul_ps(ray.d[1], e2z), _mm_mul_ps(ray.d[2], e2y));
+    __m128 py = _mm_sub_ps(_mm_mul_ps(ray.d[2], e2x), _mm_mul_ps(ray.d[0], e2z));
+    __m128 pz = _mm_sub_ps(_mm_mul_ps(ray.d[0], e2y), _mm_mul_ps(ray.d[1], e2x));
+
+    __m128 det = _mm_add_ps(_mm_mul_ps(e1x, px), _mm_add_ps(_mm_mul_ps(e1y, py), _mm_mul_ps(e1z, pz)));
+    __m128 valid = _mm_or_ps(_mm_cmple_ps(det, _mm_set1_ps(-1e-8f)), _mm_cmpge_ps(det, _mm_set1_ps(1e-8f)));
+    __m128 invDet = _mm_div_ps(_mm_set1_ps(1.0f), det);
+
+    /* tvec = o - p0 */
+    __m128 tx = _mm_sub_ps(ray.o[0], _mm_load_ps(block.p0[0]));
+    __m128 ty = _mm_sub_ps(ray.o[1], _mm_load_ps(block.p0[1]));
+    __m128 tz = _mm_sub_ps(ray.o[2], _mm_load_ps(block.p0[2]));
+
+    __m128 uu = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(tx, px), _mm_add_ps(_mm_mul_ps(ty, py), _mm_mul_ps(tz, pz))), invDet);
+    valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpge_ps(uu, _mm_setzero_ps()), _mm_cmple_ps(uu, _mm_set1_ps(1.0f))));
+
+    /* qvec = tvec x edge1 */
+    __m128 qx = _mm_sub_ps(_mm_mul_ps(ty, e1z), _mm_mul_ps(tz, e1y));
+    __m128 qy = _mm_sub_ps(_mm_mul_ps(tz, e1x), _mm_mul_ps(tx, e1z));
+    __m128 qz = _mm_sub_ps(_mm_mul_ps(tx, e1y), _mm_mul_ps(ty, e1x));
+
+    __m128 vv = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(ray.d[0], qx), _mm_add_ps(_mm_mul_ps(ray.d[1], qy), _mm_mul_ps(ray.d[2], qz))), invDet);
+    valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpge_ps(vv, _mm_setzero_ps()),
+                                         _mm_cmple_ps(_mm_add_ps(vv, uu), _mm_set1_ps(1.0f))));
+
+    __m128 tt = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(e2x, qx), _mm_add_ps(_mm_mul_ps(e2y, qy), _mm_mul_ps(e2z, qz))), invDet);
+    valid = _mm_and_ps(valid, _mm_and_ps(_mm_cmpge_ps(tt, _mm_set1_ps(mint)), _mm_cmplt_ps(tt, _mm_set1_ps(maxt))));
+
+    mask = _mm_movemask_ps(valid);
+    if (mask == 0)
+        return -1;
+
+    _mm_storeu_ps(us, uu);
+    _mm_storeu_ps(vs, vv);
+    _mm_storeu_ps(ts, tt);
+#else
+    for (int lane = 0; lane < LUMINA_TRIANGLE_BLOCK_WIDTH; lane++) {
+        float e1[3] = { block.edge1[0][lane], block.edge1[1][lane], block.edge1[2][lane] };
+        float e2[3] = { block.edge2[0][lane], block.edge2[1][lane], block.edge2[2][lane] };
+
+        float pvec[3] = { ray.d[1] * e2[2] - ray.d[2] * e2[1],
+                          ray.d[2] * e2[0] - ray.d[0] * e2[2],
+                          ray.d[0] * e2[1] - ray.d[1] * e2[0] };
+
+        float det = e1[0] * pvec[0] + (e1[1] * pvec[1] + e1[2] * pvec[2]);
+        if (det > -1e-8f && det < 1e-8f)
+            continue;
+        float invDet = 1 / det;
+
+        float tvec[3] = { ray.o[0] - block.p0[0][lane], ray.o[1] - block.p0[1][lane], ray.o[2] - block.p0[2][lane] };
+
+        us[lane] = (tvec[0] * pvec[0] + (tvec[1] * pvec[1] + tvec[2] * pvec[2])) * invDet;
+        if (!(us[lane] >= 0.0f && us[lane] <= 1.0f))
+            continue;
+
+        float qvec[3] = { tvec[1] * e1[2] - tvec[2] * e1[1],
+                          tvec[2] * e1[0] - tvec[0] * e1[2],
+                          tvec[0] * e1[1] - tvec[1] * e1[0] };
+
+        vs[lane] = (ray.d[0] * qvec[0] + (ray.d[1] * qvec[1] + ray.d[2] * qvec[2])) * invDet;
+        if (!(vs[lane] >= 0.0f && vs[lane] + us[lane] <= 1.0f))
+            continue;
+
+        ts[lane] = (e2[0] * qvec[0] + (e2[1] * qvec[1] + e2[2] * qvec[2])) * invDet;
+        if (ts[lane] >= mint && ts[lane] < maxt)
+            mask |= 1 << lane;
+    }
+
+    if (mask == 0)
+        return -1;
+#endif
+
+    int best = -1;
+    for (int lane = 0; lane < LUMINA_TRIANGLE_BLOCK_WIDTH; lane++) {
+        if ((mask >> lane) & 1 && (best < 0 || ts[lane] < ts[best]))
+            best = lane;
+    }
+
+    u = us[best];
+    v = vs[best];
+    t = ts[best];
+    return best;
+}
+
+LUMINA_NAMESPACE_END
@@ -3,55 +3,305 @@
 //
 
 #include "accel.h"
+#include "utils/timer.h"
+#include "utils/resourceCache.h"
+#include "utils/stats.h"
 
 #include <tbb/parallel_for.h>
 #include <tbb/blocked_range.h>
 #include <tbb/task_arena.h>
+#include <tbb/parallel_reduce.h>
+#include <tbb/parallel_invoke.h>
 #include <Eigen/Geometry>
-#include <stack>
-#include <queue>
+#include <fstream>
 
 LUMINA_NAMESPACE_BEGIN
 
+    Accel::~Accel() = default;
+
     void Accel::addMesh(Mesh *mesh) {
         m_meshes.push_back(mesh);
         m_bbox.expandBy(mesh->getBoundingBox());
     }
 
     void Accel::build() {
-        /* Nothing to do here for now */
+        StatPhase phase(EPhaseAccelBuild);
         uint32_t total_triangles = 0;
         for (uint32_t i = 0; i < m_meshes.size(); i++) {
             total_triangles += m_meshes.at(i)->getTriangleCount();
         }
 
-        uint32_t offset = 0;
-        std::vector<uint32_t> triangles(total_triangles);
-        std::vector<uint32_t> mesh_indices(total_triangles);
-        for (uint32_t current_mesh = 0; current_mesh < m_meshes.size(); current_mesh++) {
-            uint32_t num_triangles_in_mesh = m_meshes.at(current_mesh)->getTriangleCount();
-            for (uint32_t i = 0; i < num_triangles_in_mesh; i++) {
-                triangles[i + offset] = i;
-                mesh_indices[i + offset] = current_mesh;
+        /* Reuse the structure of a previously loaded scene with the same geometry */
+        std::string sharedKey;
+        if (getResourceCache()->isEnabled()) {
+            sharedKey = tfm::format("accel:%i", computeCacheHash());
+            if (std::shared_ptr<const AccelArrays> arrays = getResourceCache()->find<AccelArrays>(sharedKey)) {
+                useSharedArrays(arrays);
+                std::cout << "Reusing the acceleration structure over " << total_triangles << " triangles" << std::endl;
+                return;
+            }
+        }
+
+        if (!m_cacheFile.empty() && loadCache()) {
+            /* Share the mapping, so that later scenes do not map the file again */
+            if (!sharedKey.empty()) {
+                auto arrays = std::make_shared<AccelArrays>();
+                arrays->file = std::move(m_cache);
+                arrays->data = m_data;
+                useSharedArrays(arrays);
+                getResourceCache()->insert<AccelArrays>(sharedKey, arrays);
+            }
+            return;
+        }
+
+        std::cout << "Building " << (m_type == EBVH ? "BVH" : m_type == EBVH4 ? "BVH4" : "octree") << " over "
+                  << total_triangles << " triangles...";
+        std::cout.flush();
+        Timer timer;
+
+        Node* root = nullptr;
+        if (m_type == EBVH || m_type == EBVH4) {
+            std::vector<PrimitiveRef> primitives(total_triangles);
+            uint32_t offset = 0;
+            for (uint32_t current_mesh = 0; current_mesh < m_meshes.size(); current_mesh++) {
+                const Mesh* mesh = m_meshes.at(current_mesh);
+                tbb::parallel_for(tbb::blocked_range<uint32_t>(0, mesh->getTriangleCount(), BVH_PARALLEL_GRAIN_SIZE),
+                    [&](const tbb::blocked_range<uint32_t> &range) {
+                        for (uint32_t i = range.begin(); i != range.end(); i++) {
+                            BoundingBox3f box = mesh->getBoundingBox(i);
+                            primitives[offset + i] = { box, box.getCenter(), i, current_mesh };
+                        }
+                    });
+                offset += mesh->getTriangleCount();
+            }
+
+            root = buildBVH(primitives, 0, (uint32_t) primitives.size());
+        } else {
+            uint32_t offset = 0;
+            std::vector<uint32_t> triangles(total_triangles);
+            std::vector<uint32_t> mesh_indices(total_triangles);
+            for (uint32_t current_mesh = 0; current_mesh < m_meshes.size(); current_mesh++) {
+                uint32_t num_triangles_in_mesh = m_meshes.at(current_mesh)->getTriangleCount();
+                for (uint32_t i = 0; i < num_triangles_in_mesh; i++) {
+                    triangles[i + offset] = i;
+                    mesh_indices[i + offset] = current_mesh;
+                }
+                offset += num_triangles_in_mesh;
+            }
+
+            root = build(m_bbox, triangles, mesh_indices);
+        }
+
+        flattenTree(root);
+        delete root;
+
+        std::cout << "done. (took " << timer.elapsedString() << ")" << std::endl;
+        std::cout << getStatistics().toString() << std::endl;
+
+        if (!m_cacheFile.empty())
+            saveCache();
+
+        if (!sharedKey.empty()) {
+            auto arrays = std::make_shared<AccelArrays>();
+            arrays->nodes = std::move(m_nodes);
+            arrays->wideNodes = std::move(m_wideNodes);
+            arrays->primitives = std::move(m_primitives);
+            arrays->blocks = std::move(m_blocks);
+            /* Moving the vectors keeps their storage, which m_data points into */
+            arrays->data = m_data;
+            useSharedArrays(arrays);
+            getResourceCache()->insert<AccelArrays>(sharedKey, arrays);
+        }
+    }
+
+    void Accel::useSharedArrays(const std::shared_ptr<const AccelArrays>& arrays) {
+        m_cache.reset();
+        m_nodes.clear();
+        m_wideNodes.clear();
+        m_primitives.clear();
+        m_blocks.clear();
+        m_data = arrays->data;
+        m_shared = arrays;
+    }
+
+    AccelStatistics Accel::getStatistics() const {
+        AccelStatistics stats;
+        if (m_data.nodeCount > 0)
+            collectStatistics(0, 1, stats);
+        else if (m_data.wideNodeCount > 0)
+            collectWideStatistics(0, 1, stats);
+
+        stats.memory = m_data.nodeCount * sizeof(LinearNode) + m_data.wideNodeCount * sizeof(WideNode) +
+                       m_data.primitiveCount * sizeof(PrimitiveIndex) + m_data.blockCount * sizeof(TriangleBlock);
+        return stats;
+    }
+
+    /// Header of an acceleration structure cache file, followed by the four arrays of \ref AccelData
+    struct AccelCacheHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t type;
+        uint64_t hash;
+        uint64_t offsets[4];
+        uint64_t counts[4];
+    };
+
+    static const char ACCEL_CACHE_MAGIC[8] = { 'L', 'U', 'M', 'A', 'C', 'C', 'E', 'L' };
+    /// Increase whenever the layout of the cached arrays or the build changes
+    static constexpr uint32_t ACCEL_CACHE_VERSION = 1;
+    /// Arrays in the cache file start at multiples of this (mapped memory is page aligned)
+    static constexpr uint64_t ACCEL_CACHE_ALIGNMENT = 64;
+
+    uint64_t Accel::computeCacheHash() const {
+        /* Build settings and layout of the cached structures */
+        const uint64_t settings[] = {
+            (uint64_t) m_type, (uint64_t) m_meshes.size(), sizeof(LinearNode), sizeof(WideNode),
+            sizeof(PrimitiveIndex), sizeof(TriangleBlock), LUMINA_TRIANGLE_BLOCK_WIDTH,
+            (uint64_t) MAX_RECURSIVE_DEPTH, (uint64_t) MAX_TRIANGLES_PER_NODE, (uint64_t) BVH_BIN_COUNT,
+            (uint64_t) BVH_MAX_DEPTH, (uint64_t) BVH_MAX_TRIANGLES_PER_LEAF
+        };
+        uint64_t hash = hashBytes(settings, sizeof(settings));
+        hash = hashBytes(&BVH_TRAVERSAL_COST, sizeof(float), hash);
+
+        /* Geometry of every mesh, in the order they were added */
+        for (const Mesh* mesh : m_meshes) {
+            const ConstMatrixXfMap& V = mesh->getVertexPositions();
+            const ConstMatrixXuMap& F = mesh->getIndices();
+            const uint64_t sizes[] = { (uint64_t) V.size(), (uint64_t) F.size() };
+
+            hash = hashBytes(sizes, sizeof(sizes), hash);
+            hash = hashBytes(V.data(), V.size() * sizeof(float), hash);
+            hash = hashBytes(F.data(), F.size() * sizeof(uint32_t), hash);
+        }
+
+        return hash;
+    }
+
+    bool Accel::loadCache() {
+        if (!std::filesystem::exists(m_cacheFile))
+            return false;
+
+        std::cout << "Loading acceleration structure from \"" << m_cacheFile << "\"...";
+        std::cout.flush();
+        Timer timer;
+
+        std::unique_ptr<MappedFile> file;
+        try {
+            file = std::make_unique<MappedFile>(m_cacheFile);
+        } catch (const std::exception& e) {
+            std::cout << "failed (" << e.what() << "), rebuilding." << std::endl;
+            return false;
+        }
+
+        AccelCacheHeader header;
+        if (file->size() < sizeof(AccelCacheHeader)) {
+            std::cout << "invalid file, rebuilding." << std::endl;
+            return false;
+        }
+        memcpy(&header, file->data(), sizeof(AccelCacheHeader));
+
+        if (memcmp(header.magic, ACCEL_CACHE_MAGIC, sizeof(ACCEL_CACHE_MAGIC)) != 0 ||
+            header.version != ACCEL_CACHE_VERSION || header.type != (uint32_t) m_type ||
+            header.hash != computeCacheHash()) {
+            std::cout << "out of date, rebuilding." << std::endl;
+            return false;
+        }
+
+        const uint64_t elementSizes[4] = {
+            sizeof(LinearNode), sizeof(WideNode), sizeof(PrimitiveIndex), sizeof(TriangleBlock)
+        };
+        for (int i = 0; i < 4; i++) {
+            if (header.offsets[i] % ACCEL_CACHE_ALIGNMENT != 0 ||
+                header.offsets[i] + header.counts[i] * elementSizes[i] > file->size()) {
+                std::cout << "truncated file, rebuilding." << std::endl;
+                return false;
             }
-            offset += num_triangles_in_mesh;
         }
 
-        m_root = build(m_bbox, triangles, mesh_indices);
+        /* Traverse the mapped arrays directly */
+        m_nodes.clear();
+        m_wideNodes.clear();
+        m_primitives.clear();
+        m_blocks.clear();
+        m_shared.reset();
+        m_data.nodes = file->at<LinearNode>(header.offsets[0]);
+        m_data.nodeCount = (uint32_t) header.counts[0];
+        m_data.wideNodes = file->at<WideNode>(header.offsets[1]);
+        m_data.wideNodeCount = (uint32_t) header.counts[1];
+        m_data.primitives = file->at<PrimitiveIndex>(header.offsets[2]);
+        m_data.primitiveCount = (uint32_t) header.counts[2];
+        m_data.blocks = file->at<TriangleBlock>(header.offsets[3]);
+        m_data.blockCount = (uint32_t) header.counts[3];
+        m_cache = std::move(file);
+
+        std::cout << "done. (took " << timer.elapsedString() << ")" << std::endl;
+        std::cout << getStatistics().toString() << std::endl;
+        return true;
+    }
+
+    void Accel::saveCache() const {
+        AccelCacheHeader header;
+        memcpy(header.magic, ACCEL_CACHE_MAGIC, sizeof(ACCEL_CACHE_MAGIC));
+        header.version = ACCEL_CACHE_VERSION;
+        header.type = (uint32_t) m_type;
+        header.hash = computeCacheHash();
+
+        const void* arrays[4] = { m_data.nodes, m_data.wideNodes, m_data.primitives, m_data.blocks };
+        header.counts[0] = m_data.nodeCount;
+        header.counts[1] = m_data.wideNodeCount;
+        header.counts[2] = m_data.primitiveCount;
+        header.counts[3] = m_data.blockCount;
+        const uint64_t elementSizes[4] = {
+            sizeof(LinearNode), sizeof(WideNode), sizeof(PrimitiveIndex), sizeof(TriangleBlock)
+        };
+
+        uint64_t offset = sizeof(AccelCacheHeader);
+        for (int i = 0; i < 4; i++) {
+            offset = (offset + ACCEL_CACHE_ALIGNMENT - 1) / ACCEL_CACHE_ALIGNMENT * ACCEL_CACHE_ALIGNMENT;
+            header.offsets[i] = offset;
+            offset += header.counts[i] * elementSizes[i];
+        }
+
+        std::ofstream os(m_cacheFile, std::ios::binary | std::ios::trunc);
+        if (!os) {
+            std::cerr << "Warning: unable to write the acceleration structure cache \"" << m_cacheFile << "\"" << std::endl;
+            return;
+        }
+
+        const char padding[ACCEL_CACHE_ALIGNMENT] = {};
+        os.write((const char *) &header, sizeof(AccelCacheHeader));
+        uint64_t position = sizeof(AccelCacheHeader);
+        for (int i = 0; i < 4; i++) {
+            os.write(padding, (std::streamsize) (header.offsets[i] - position));
+            os.write((const char *) arrays[i], (std::streamsize) (header.counts[i] * elementSizes[i]));
+            position = header.offsets[i] + header.counts[i] * elementSizes[i];
+        }
+
+        if (!os)
+            std::cerr << "Warning: unable to write the acceleration structure cache \"" << m_cacheFile << "\"" << std::endl;
+    }
+
+    bool Accel::occluded(const Ray3f &ray_) const {
+        uint32_t f = (uint32_t) -1;
+        Ray3f ray(ray_);
 
-        flattenTree();
+        if (m_type == EBVH4)
+            return intersectWide<true>(ray, nullptr, f);
+        return intersectIterative<true>(ray, nullptr, f);
     }
 
     bool Accel::rayIntersect(const Ray3f &ray_, Intersection &its, bool shadowRay) const {
+        if (shadowRay)
+            return occluded(ray_);
+
         bool foundIntersection = false;  // Was an intersection found so far?
         uint32_t f = (uint32_t) -1;      // Triangle index of the closest intersection
 
         Ray3f ray(ray_); /// Make a copy of the ray (we will need to update its '.maxt' value)
-        /* Brute force search through all triangles */
-         foundIntersection = intersectRecursive(*m_root, ray, its, shadowRay, f);
-        // foundIntersection = intersectIterative(ray, its, shadowRay, f);
-        if (shadowRay)
-            return foundIntersection;
+        if (m_type == EBVH4)
+            foundIntersection = intersectWide<false>(ray, &its, f);
+        else
+            foundIntersection = intersectIterative<false>(ray, &its, f);
 
         if (foundIntersection) {
             /* At this point, we now know that there is an intersection,
@@ -67,12 +317,13 @@ LUMINA_NAMESPACE_BEGIN
 
             /* References to all relevant mesh buffers */
             const Mesh *mesh   = its.mesh;
-            const MatrixXf &V  = mesh->getVertexPositions();
-            const MatrixXf &N  = mesh->getVertexNormals();
-            const MatrixXf &UV = mesh->getVertexTexCoords();
-            const MatrixXu &F  = mesh->getIndices();
+            const ConstMatrixXfMap &V  = mesh->getVertexPositions();
+            const ConstMatrixXfMap &N  = mesh->getVertexNormals();
+            const ConstMatrixXfMap &UV = mesh->getVertexTexCoords();
+            const ConstMatrixXuMap &F  = mesh->getIndices();
 
             /* Vertex indices of the triangle */
+            its.triangle = f;
             uint32_t idx0 = F(0, f), idx1 = F(1, f), idx2 = F(2, f);
 
             Point3f p0 = V.col(idx0), p1 = V.col(idx1), p2 = V.col(idx2);
@@ -109,50 +360,74 @@ LUMINA_NAMESPACE_BEGIN
         return foundIntersection;
     }
 
-    bool Accel::intersectIterative(Ray3f& ray, Intersection& its, bool shadowRay, uint32_t& hit_index) const
+    template <bool anyHit>
+    bool Accel::intersectIterative(Ray3f& ray, Intersection* its, uint32_t& hit_index) const
     {
+        if (m_data.nodeCount == 0)
+            return false;
+
+        /* Children are visited front-to-back based on the sign of the ray
+           direction, so no per-node sorting is needed */
+        uint32_t signMask = (ray.d.x() < 0 ? 1 : 0) | (ray.d.y() < 0 ? 2 : 0) | (ray.d.z() < 0 ? 4 : 0);
+        const TriangleBlockRay blockRay(ray);
+
+        struct StackEntry {
+            uint32_t index;
+            float nearT;
+        };
+
         bool foundIntersection = false;
-        std::stack<Node*> queue;
-        queue.push(m_root);
-
-        while (!queue.empty()) {
-            Node currentNode = *queue.top();
-            queue.pop();
-
-            if (currentNode.box.rayIntersect(ray)) {
-                for (uint32_t i = 0; i < currentNode.triangle_indices.size(); i++) {
-                    uint32_t triangle_index = currentNode.triangle_indices[i];
-                    uint32_t mesh_index = currentNode.mesh_indices[i];
-
-                    float u, v, t;
-                    if (m_meshes[mesh_index]->rayIntersect(triangle_index, ray, u, v, t) && t < ray.maxt) {
-                        if (shadowRay)
-                            return true;
-
-                        ray.maxt = its.t = t;
-                        its.uv = Point2f(u, v);
-                        its.mesh = m_meshes[mesh_index];
-                        hit_index = triangle_index;
-                        foundIntersection = true;
-                    }
+        RayStatistics rayStats;
+        StackEntry stack[ACCEL_STACK_SIZE];
+        int stackSize = 0;
+
+        float nearT, farT;
+        if (!m_data.nodes[0].box.rayIntersect(ray, nearT, farT) || farT < ray.mint || nearT > ray.maxt)
+            return false;
+        stack[stackSize++] = { 0, nearT };
+
+        while (stackSize > 0) {
+            StackEntry entry = stack[--stackSize];
+
+            /* A closer hit was found since this node was pushed */
+            if (entry.nearT > ray.maxt)
+                continue;
+
+            const LinearNode& node = m_data.nodes[entry.index];
+            rayStats.visitNode();
+
+            if (node.childCount == 0) {
+                rayStats.testTriangles(node.primitiveCount);
+                if (intersectLeaf<anyHit>(node.offset, node.primitiveCount, blockRay, ray, its, hit_index)) {
+                    if (anyHit)
+                        return true;
+                    foundIntersection = true;
                 }
-                if (foundIntersection && shadowRay)
-                    return true;
-
-                if (!currentNode.children.empty()) {
-                    std::vector<std::pair<Node*, float>> sortedNodes(currentNode.children.size());
-                    for (uint32_t i = 0; i < currentNode.children.size(); i++) {
-                        auto& child = currentNode.children.at(i);
-                        sortedNodes[i] = std::pair<Node*, float>(child, child->box.distanceTo(ray.o));
-                    }
-                    std::sort(sortedNodes.begin(), sortedNodes.end(), [](const std::pair<Node*, float>& a,
-                        const std::pair<Node*, float>& b) {
-                            return a.second > b.second;
-                        });
+                continue;
+            }
 
-                    for (auto& pair : sortedNodes) {
-                        queue.push(pair.first);
-                    }
+            auto pushChild = [&](uint32_t childIndex) {
+                float childNear, childFar;
+                if (m_data.nodes[childIndex].box.rayIntersect(ray, childNear, childFar) &&
+                    childFar >= ray.mint && childNear <= ray.maxt)
+                    stack[stackSize++] = { childIndex, childNear };
+            };
+
+            /* The near child is pushed last so that it is popped first */
+            if (m_type == EBVH) {
+                bool nearIsSecond = (signMask >> node.axis) & 1;
+                pushChild(node.offset + (nearIsSecond ? 0 : 1));
+                pushChild(node.offset + (nearIsSecond ? 1 : 0));
+            } else {
+                /* Octree children are stored in octant order, 'axis' holds the occupied octants */
+                uint32_t slots[8];
+                for (uint32_t octant = 0, slot = 0; octant < 8; octant++)
+                    slots[octant] = (node.axis >> octant) & 1 ? slot++ : 0;
+
+                for (int k = 7; k >= 0; k--) {
+                    uint32_t octant = (uint32_t) k ^ signMask;
+                    if ((node.axis >> octant) & 1)
+                        pushChild(node.offset + slots[octant]);
                 }
             }
         }
@@ -160,51 +435,98 @@ LUMINA_NAMESPACE_BEGIN
         return foundIntersection;
     }
 
-    bool Accel::intersectRecursive(const Node &node, Ray3f &ray, Intersection &its, bool shadowRay,
-                                   uint32_t &hit_idx) const {
-        bool foundIntersection = false;
-
-        if (!node.box.rayIntersect(ray))
+    template <bool anyHit>
+    bool Accel::intersectWide(Ray3f& ray, Intersection* its, uint32_t& hit_index) const
+    {
+        if (m_data.wideNodeCount == 0 || m_data.wideNodes[0].childCount == 0)
             return false;
 
-        for (uint32_t i = 0; i < node.triangle_indices.size(); i++) {
-            uint32_t triangle_index = node.triangle_indices[i];
-            uint32_t mesh_index = node.mesh_indices[i];
+        const TriangleBlockRay blockRay(ray);
+        const BoundingBox4Ray boxRay(ray);
 
-            float u, v, t;
-            if (m_meshes[mesh_index]->rayIntersect(triangle_index, ray, u, v, t) && t < ray.maxt) {
-                if (shadowRay)
-                    return true;
-
-                ray.maxt = its.t = t;
-                its.uv = Point2f(u, v);
-                its.mesh = m_meshes[mesh_index];
-                hit_idx = triangle_index;
-                foundIntersection = true;
+        /* Entries are either wide nodes (primitiveCount == 0) or leaves */
+        struct StackEntry {
+            uint32_t offset;
+            uint32_t primitiveCount;
+            float nearT;
+        };
+
+        bool foundIntersection = false;
+        RayStatistics rayStats;
+        StackEntry stack[ACCEL_STACK_SIZE];
+        int stackSize = 0;
+        stack[stackSize++] = { 0, 0, ray.mint };
+
+        while (stackSize > 0) {
+            StackEntry entry = stack[--stackSize];
+
+            /* A closer hit was found since this entry was pushed */
+            if (entry.nearT > ray.maxt)
+                continue;
+            rayStats.visitNode();
+
+            if (entry.primitiveCount > 0) {
+                rayStats.testTriangles(entry.primitiveCount);
+                if (intersectLeaf<anyHit>(entry.offset, entry.primitiveCount, blockRay, ray, its, hit_index)) {
+                    if (anyHit)
+                        return true;
+                    foundIntersection = true;
+                }
+                continue;
             }
-        }
 
-        if (!node.children.empty()) {
-            std::vector<std::pair<Node*, float>> sortedNodes(node.children.size());
-            for (uint32_t i = 0; i < node.children.size(); i++) {
-                auto &child = node.children.at(i);
-                sortedNodes[i] = std::pair<Node*, float>(child, child->box.distanceTo(ray.o));
+            const WideNode& node = m_data.wideNodes[entry.offset];
+            float nearT[4];
+            int mask = intersectBoundingBox4(node.bounds, boxRay, ray.mint, ray.maxt, nearT) & ((1 << node.childCount) - 1);
+
+            /* Sort the hit children by decreasing entry distance, so that the nearest one is popped first */
+            int lanes[4], hitCount = 0;
+            for (int lane = 0; lane < 4; lane++) {
+                if (!((mask >> lane) & 1))
+                    continue;
+
+                int j = hitCount++;
+                for (; j > 0 && nearT[lanes[j - 1]] < nearT[lane]; j--)
+                    lanes[j] = lanes[j - 1];
+                lanes[j] = lane;
             }
-            std::sort(sortedNodes.begin(), sortedNodes.end(), [](const std::pair<Node*,float> &a,
-                                                                 const std::pair<Node*,float> &b) {
-                return a.second < b.second;
-            });
 
-            for (auto &child : sortedNodes) {
-                foundIntersection = intersectRecursive(*child.first, ray, its, shadowRay, hit_idx) || foundIntersection;
-                if (foundIntersection && shadowRay)
-                    return true;
+            for (int k = 0; k < hitCount; k++) {
+                int lane = lanes[k];
+                stack[stackSize++] = { node.offset[lane], node.primitiveCount[lane], nearT[lane] };
             }
         }
 
         return foundIntersection;
     }
 
+    template <bool anyHit>
+    bool Accel::intersectLeaf(uint32_t offset, uint32_t primitiveCount, const TriangleBlockRay& blockRay,
+                              Ray3f& ray, Intersection* its, uint32_t& hit_index) const
+    {
+        uint32_t blockStart = offset / LUMINA_TRIANGLE_BLOCK_WIDTH;
+        uint32_t blockEnd = (offset + primitiveCount + LUMINA_TRIANGLE_BLOCK_WIDTH - 1) / LUMINA_TRIANGLE_BLOCK_WIDTH;
+        bool foundIntersection = false;
+
+        for (uint32_t i = blockStart; i < blockEnd; i++) {
+            float u, v, t;
+            int lane = intersectTriangleBlock(m_data.blocks[i], blockRay, ray.mint, ray.maxt, u, v, t);
+            if (lane < 0)
+                continue;
+            if (anyHit)
+                return true;
+
+            const PrimitiveIndex& primitive = m_data.primitives[i * LUMINA_TRIANGLE_BLOCK_WIDTH + lane];
+            ray.maxt = its->t = t;
+            its->uv = Point2f(u, v);
+            its->mesh = m_meshes[primitive.mesh_index];
+            hit_index = primitive.triangle_index;
+            foundIntersection = true;
+        }
+
+        return foundIntersection;
+    }
+
     Node *Accel::build(BoundingBox3f &box, std::vector<uint32_t> &triangle_indices, std::vector<uint32_t> &mesh_indices, int recursive_depth) {
         if (triangle_indices.empty())
             return nullptr;
@@ -212,8 +534,8 @@ LUMINA_NAMESPACE_BEGIN
         amount++;
         if (triangle_indices.size() < MAX_TRIANGLES_PER_NODE || recursive_depth > MAX_RECURSIVE_DEPTH) {
             Node* newNode = new Node();
-            newNode->triangle_indices = std::vector<uint32_t>(triangle_indices);
-            newNode->mesh_indices = std::vector<uint32_t>(mesh_indices);
+            newNode->triangle_indices = std::move(triangle_indices);
+            newNode->mesh_indices = std::move(mesh_indices);
             newNode->box = BoundingBox3f(box);
 
             return newNode;
@@ -243,10 +565,8 @@ LUMINA_NAMESPACE_BEGIN
         tbb::blocked_range<int> range(0, 8);
         auto map = [&](const tbb::blocked_range<int> &range) {
             for (int i = range.begin(); i != range.end(); i++) {
-                BoundingBox3f childBox = boxes.at(i);
-                auto list = lists.at(i);
-                auto mesh_indices_list = mesh_indices_lists.at(i);
-                Node* result = build(childBox, list, mesh_indices_list, recursive_depth+1);
+                /* The child lists are handed over, not copied */
+                Node* result = build(boxes[i], lists[i], mesh_indices_lists[i], recursive_depth+1);
 
                 if (result != nullptr)
                     nodes[i] = result;
@@ -254,44 +574,367 @@ LUMINA_NAMESPACE_BEGIN
         };
         tbb::parallel_for(range, map);
 
-        for (auto value : nodes) {
-            if (value != nullptr)
-                parent->children.push_back(value);
+        for (int i = 0; i < 8; i++) {
+            if (nodes[i] != nullptr) {
+                parent->children.push_back(nodes[i]);
+                parent->axis |= 1 << i;
+            }
         }
 
         return parent;
     }
 
-    void Accel::flattenTree()
+    Node *Accel::buildBVH(std::vector<PrimitiveRef> &primitives, uint32_t start, uint32_t end, int depth) {
+        Node* node = new Node();
+        uint32_t count = end - start;
+
+        /* Large ranges are reduced in parallel, small ones on the calling task */
+        auto reduce = [&](auto identity, auto body, auto join) {
+            if (count < BVH_PARALLEL_BINNING_THRESHOLD)
+                return body(tbb::blocked_range<uint32_t>(start, end), identity);
+            return tbb::parallel_reduce(tbb::blocked_range<uint32_t>(start, end, BVH_PARALLEL_GRAIN_SIZE),
+                                        identity, body, join);
+        };
+
+        struct Bounds {
+            BoundingBox3f box;
+            BoundingBox3f centroidBox;
+        };
+
+        Bounds bounds = reduce(Bounds(),
+            [&](const tbb::blocked_range<uint32_t> &range, Bounds result) {
+                for (uint32_t i = range.begin(); i != range.end(); i++) {
+                    result.box.expandBy(primitives[i].box);
+                    result.centroidBox.expandBy(primitives[i].centroid);
+                }
+                return result;
+            },
+            [](Bounds a, const Bounds &b) {
+                a.box.expandBy(b.box);
+                a.centroidBox.expandBy(b.centroidBox);
+                return a;
+            });
+        node->box = bounds.box;
+        const BoundingBox3f &centroidBox = bounds.centroidBox;
+
+        auto makeLeaf = [&]() {
+            node->triangle_indices.reserve(count);
+            node->mesh_indices.reserve(count);
+            for (uint32_t i = start; i < end; i++) {
+                node->triangle_indices.push_back(primitives[i].triangle_index);
+                node->mesh_indices.push_back(primitives[i].mesh_index);
+            }
+            return node;
+        };
+
+        if (count <= 2 || depth >= BVH_MAX_DEPTH)
+            return makeLeaf();
+
+        /* Bin the centroids along every axis in a single pass, then sweep
+           the bin boundaries, evaluating the surface area heuristic for each
+           candidate split */
+        struct Bin {
+            BoundingBox3f box;
+            uint32_t count = 0;
+        };
+
+        struct Bins {
+            Bin bins[3][BVH_BIN_COUNT];
+        };
+
+        Vector3f extents = centroidBox.getExtents();
+        Vector3f scale;
+        for (int axis = 0; axis < 3; axis++)
+            scale[axis] = extents[axis] > 0.0f ? BVH_BIN_COUNT / extents[axis] : 0.0f;
+
+        auto binIndex = [&](const PrimitiveRef &ref, int axis) {
+            return std::min(BVH_BIN_COUNT - 1, (int) ((ref.centroid[axis] - centroidBox.min[axis]) * scale[axis]));
+        };
+
+        Bins binning = reduce(Bins(),
+            [&](const tbb::blocked_range<uint32_t> &range, Bins result) {
+                for (uint32_t i = range.begin(); i != range.end(); i++) {
+                    for (int axis = 0; axis < 3; axis++) {
+                        Bin &bin = result.bins[axis][binIndex(primitives[i], axis)];
+                        bin.count++;
+                        bin.box.expandBy(primitives[i].box);
+                    }
+                }
+                return result;
+            },
+            [](Bins a, const Bins &b) {
+                for (int axis = 0; axis < 3; axis++) {
+                    for (int i = 0; i < BVH_BIN_COUNT; i++) {
+                        a.bins[axis][i].count += b.bins[axis][i].count;
+                        a.bins[axis][i].box.expandBy(b.bins[axis][i].box);
+                    }
+                }
+                return a;
+            });
+
+        float bestCost = Infinity;
+        int bestAxis = -1, bestSplit = -1;
+
+        for (int axis = 0; axis < 3; axis++) {
+            if (extents[axis] <= 0.0f)
+                continue;
+
+            const Bin *bins = binning.bins[axis];
+
+            /* rightArea[i], rightCount[i] describe bins (i, BVH_BIN_COUNT) */
+            float rightArea[BVH_BIN_COUNT - 1];
+            uint32_t rightCount[BVH_BIN_COUNT - 1];
+            BoundingBox3f accum;
+            uint32_t accumCount = 0;
+            for (int i = BVH_BIN_COUNT - 1; i > 0; i--) {
+                accum.expandBy(bins[i].box);
+                accumCount += bins[i].count;
+                rightArea[i - 1] = accumCount > 0 ? accum.getSurfaceArea() : 0.0f;
+                rightCount[i - 1] = accumCount;
+            }
+
+            accum.reset();
+            accumCount = 0;
+            for (int i = 0; i < BVH_BIN_COUNT - 1; i++) {
+                accum.expandBy(bins[i].box);
+                accumCount += bins[i].count;
+                if (accumCount == 0 || rightCount[i] == 0)
+                    continue;
+
+                float cost = accumCount * accum.getSurfaceArea() + rightCount[i] * rightArea[i];
+                if (cost < bestCost) {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestSplit = i;
+                }
+            }
+        }
+
+        /* All centroids coincide, no split can separate them */
+        if (bestAxis < 0)
+            return makeLeaf();
+
+        float leafCost = (float) count;
+        bestCost = BVH_TRAVERSAL_COST + bestCost / node->box.getSurfaceArea();
+        if (count <= BVH_MAX_TRIANGLES_PER_LEAF && bestCost >= leafCost)
+            return makeLeaf();
+
+        auto middle = std::partition(primitives.begin() + start, primitives.begin() + end,
+            [&](const PrimitiveRef& ref) { return binIndex(ref, bestAxis) <= bestSplit; });
+        uint32_t mid = (uint32_t) (middle - primitives.begin());
+
+        /* Both halves are disjoint ranges of the same array, so large
+           subtrees can be built as independent tasks */
+        node->axis = bestAxis;
+        node->children.resize(2);
+        if (count >= BVH_PARALLEL_BUILD_THRESHOLD) {
+            tbb::parallel_invoke(
+                [&] { node->children[0] = buildBVH(primitives, start, mid, depth + 1); },
+                [&] { node->children[1] = buildBVH(primitives, mid, end, depth + 1); });
+        } else {
+            node->children[0] = buildBVH(primitives, start, mid, depth + 1);
+            node->children[1] = buildBVH(primitives, mid, end, depth + 1);
+        }
+
+        return node;
+    }
+
+    void Accel::collectStatistics(uint32_t index, uint32_t depth, AccelStatistics &stats) const {
+        const LinearNode& node = m_data.nodes[index];
+        stats.nodeCount++;
+        stats.maxDepth = std::max(stats.maxDepth, depth);
+
+        if (node.childCount == 0)
+            stats.addLeaf(node.primitiveCount);
+
+        for (uint32_t i = 0; i < node.childCount; i++)
+            collectStatistics(node.offset + i, depth + 1, stats);
+    }
+
+    void Accel::collectWideStatistics(uint32_t index, uint32_t depth, AccelStatistics &stats) const {
+        const WideNode& node = m_data.wideNodes[index];
+        stats.nodeCount++;
+        stats.maxDepth = std::max(stats.maxDepth, depth);
+
+        for (uint32_t lane = 0; lane < node.childCount; lane++) {
+            if (node.primitiveCount[lane] == 0) {
+                collectWideStatistics(node.offset[lane], depth + 1, stats);
+            } else {
+                stats.nodeCount++;
+                stats.maxDepth = std::max(stats.maxDepth, depth + 1);
+                stats.addLeaf(node.primitiveCount[lane]);
+            }
+        }
+    }
+
+    void AccelStatistics::addLeaf(uint32_t size) {
+        int bucket = 0;
+        while (bucket < 7 && size > (bucket == 0 ? 0u : 1u << (bucket - 1)))
+            bucket++;
+
+        leafCount++;
+        primitiveCount += size;
+        leafSizes[bucket]++;
+    }
+
+    std::string AccelStatistics::toString() const {
+        return tfm::format(
+                "AccelStatistics[\n"
+                "  nodes = %i,\n"
+                "  leaves = %i,\n"
+                "  primitive references = %i,\n"
+                "  max depth = %i,\n"
+                "  memory = %s,\n"
+                "  leaf sizes = { 0: %i, 1: %i, 2: %i, 3-4: %i, 5-8: %i, 9-16: %i, 17-32: %i, 33+: %i }\n"
+                "]",
+                nodeCount, leafCount, primitiveCount, maxDepth, memString(memory),
+                leafSizes[0], leafSizes[1], leafSizes[2], leafSizes[3],
+                leafSizes[4], leafSizes[5], leafSizes[6], leafSizes[7]
+        );
+    }
+
+    void Accel::flattenTree(const Node* root)
     {
-        std::queue<Node*> queue;
-        queue.push(m_root);
-        int index = 0;
+        m_data = AccelData();
+        m_cache.reset();
+        m_shared.reset();
+        m_nodes.clear();
+        m_wideNodes.clear();
+        m_primitives.clear();
+        m_blocks.clear();
+        if (!root)
+            return;
+
+        if (m_type == EBVH4) {
+            m_wideNodes.resize(1);
+            flattenWideNode(root, 0);
+            m_wideNodes.shrink_to_fit();
+        } else {
+            m_nodes.resize(1);
+            flattenNode(root, 0);
+            m_nodes.shrink_to_fit();
+        }
+
+        buildTriangleBlocks();
+
+        m_data.nodes = m_nodes.data();
+        m_data.nodeCount = (uint32_t) m_nodes.size();
+        m_data.wideNodes = m_wideNodes.data();
+        m_data.wideNodeCount = (uint32_t) m_wideNodes.size();
+        m_data.primitives = m_primitives.data();
+        m_data.primitiveCount = (uint32_t) m_primitives.size();
+        m_data.blocks = m_blocks.data();
+        m_data.blockCount = (uint32_t) m_blocks.size();
+    }
 
-        m_flattenedNodes.resize(1);
+    void Accel::flattenNode(const Node* node, uint32_t index)
+    {
+        LinearNode& linear = m_nodes[index];
+        linear.box = node->box;
+        linear.primitiveCount = (uint16_t) node->triangle_indices.size();
+        linear.childCount = (uint8_t) node->children.size();
+        linear.axis = (uint8_t) node->axis;
+
+        if (linear.childCount == 0) {
+            linear.offset = appendLeaf(node);
+            return;
+        }
 
-        while (!queue.empty()) {
-            Node* current = queue.front();
-            FlatNode& currentFlat = m_flattenedNodes.at(index);
-            uint32_t childrenSize = current->children.size();
+        /* Reserve contiguous slots for all children before descending */
+        uint32_t childStart = (uint32_t) m_nodes.size();
+        linear.offset = childStart;
+        m_nodes.resize(m_nodes.size() + node->children.size());
 
-            currentFlat.box = current->box;
-            currentFlat.mesh_indices = current->mesh_indices;
-            currentFlat.triangle_indices = current->triangle_indices;
-            currentFlat.childIndexStart = m_flattenedNodes.size();
-            currentFlat.childSize = childrenSize;
+        for (uint32_t i = 0; i < node->children.size(); i++)
+            flattenNode(node->children[i], childStart + i);
+    }
 
-            for (int i = 0; i < childrenSize; i++) {
-                queue.push(current->children.at(i));
+    void Accel::flattenWideNode(const Node* node, uint32_t index)
+    {
+        /* Collapse the binary tree by repeatedly opening the interior
+           child with the largest surface area until all lanes are used */
+        std::vector<const Node*> lanes;
+        if (node->children.empty())
+            lanes.push_back(node);
+        else
+            lanes.assign(node->children.begin(), node->children.end());
+
+        while (lanes.size() < 4) {
+            int largest = -1;
+            for (int i = 0; i < (int) lanes.size(); i++) {
+                if (!lanes[i]->children.empty() &&
+                    (largest < 0 || lanes[i]->box.getSurfaceArea() > lanes[largest]->box.getSurfaceArea()))
+                    largest = i;
             }
-            if (childrenSize > 0)
-                m_flattenedNodes.resize(m_flattenedNodes.size() + current->children.size());
+            if (largest < 0 || lanes.size() + lanes[largest]->children.size() - 1 > 4)
+                break;
 
-            queue.pop();
-            index++;
+            const Node* opened = lanes[largest];
+            lanes.erase(lanes.begin() + largest);
+            lanes.insert(lanes.begin() + largest, opened->children.begin(), opened->children.end());
         }
 
+        /* Lanes without primitives would read as interior children, so leave out empty leaves
+           (a root leaf without primitives, for an empty scene, becomes a node without lanes) */
+        lanes.erase(std::remove_if(lanes.begin(), lanes.end(), [](const Node* lane) {
+            return lane->children.empty() && lane->triangle_indices.empty();
+        }), lanes.end());
+
+        m_wideNodes[index].childCount = (uint32_t) lanes.size();
+        for (uint32_t lane = 0; lane < lanes.size(); lane++) {
+            const Node* child = lanes[lane];
+            m_wideNodes[index].bounds.set((int) lane, child->box);
+
+            if (child->children.empty()) {
+                uint32_t offset = appendLeaf(child);
+                m_wideNodes[index].offset[lane] = offset;
+                m_wideNodes[index].primitiveCount[lane] = (uint16_t) child->triangle_indices.size();
+            } else {
+                /* Note: the recursion may reallocate m_wideNodes */
+                uint32_t childIndex = (uint32_t) m_wideNodes.size();
+                m_wideNodes.emplace_back();
+                m_wideNodes[index].offset[lane] = childIndex;
+                m_wideNodes[index].primitiveCount[lane] = 0;
+                flattenWideNode(child, childIndex);
+            }
+        }
+    }
 
+    uint32_t Accel::appendLeaf(const Node* node)
+    {
+        if (node->triangle_indices.size() > std::numeric_limits<uint16_t>::max())
+            throw LuminaException("Accel: leaf with %i triangles exceeds the linear node limit",
+                                  node->triangle_indices.size());
+
+        /* Start every leaf on a fresh triangle block */
+        m_primitives.resize((m_primitives.size() + LUMINA_TRIANGLE_BLOCK_WIDTH - 1) / LUMINA_TRIANGLE_BLOCK_WIDTH
+                            * LUMINA_TRIANGLE_BLOCK_WIDTH, { (uint32_t) -1, (uint32_t) -1 });
+
+        uint32_t offset = (uint32_t) m_primitives.size();
+        for (size_t i = 0; i < node->triangle_indices.size(); i++)
+            m_primitives.push_back({ node->triangle_indices[i], node->mesh_indices[i] });
+        return offset;
+    }
+
+    void Accel::buildTriangleBlocks()
+    {
+        m_primitives.resize((m_primitives.size() + LUMINA_TRIANGLE_BLOCK_WIDTH - 1) / LUMINA_TRIANGLE_BLOCK_WIDTH
+                            * LUMINA_TRIANGLE_BLOCK_WIDTH, { (uint32_t) -1, (uint32_t) -1 });
+        m_primitives.shrink_to_fit();
+
+        /* Gather the vertices of every leaf into blocks, padding lanes stay empty */
+        m_blocks.resize(m_primitives.size() / LUMINA_TRIANGLE_BLOCK_WIDTH);
+        for (size_t i = 0; i < m_primitives.size(); i++) {
+            const PrimitiveIndex& primitive = m_primitives[i];
+            if (primitive.mesh_index == (uint32_t) -1)
+                continue;
+
+            const ConstMatrixXfMap& V = m_meshes[primitive.mesh_index]->getVertexPositions();
+            const ConstMatrixXuMap& F = m_meshes[primitive.mesh_index]->getIndices();
+            m_blocks[i / LUMINA_TRIANGLE_BLOCK_WIDTH].setTriangle((int) (i % LUMINA_TRIANGLE_BLOCK_WIDTH),
+                    V.col(F(0, primitive.triangle_index)), V.col(F(1, primitive.triangle_index)),
+                    V.col(F(2, primitive.triangle_index)));
+        }
     }
 
     std::vector<BoundingBox3f> subdivideBox(BoundingBox3f &parent) {
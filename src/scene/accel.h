@@ -5,50 +5,223 @@
 #pragma once
 
 #include "primitives/mesh.h"
+#include "primitives/triangleBlock.h"
+#include "primitives/bbox4.h"
+#include "utils/mappedFile.h"
+
+#include <atomic>
 
 LUMINA_NAMESPACE_BEGIN
 
+/// Pointer-based node, only used while building (see \ref LinearNode)
 struct Node {
     BoundingBox3f box;
     std::vector<Node*> children;
     std::vector<uint32_t> triangle_indices;
     std::vector<uint32_t> mesh_indices;
+    /// Split axis (BVH) or mask of occupied octants (octree)
+    int axis = 0;
 
     Node() = default;
+    ~Node() {
+        for (Node* child : children)
+            delete child;
+    }
 };
 
-struct FlatNode {
+/**
+ * \brief Node of the linearized tree that is used for traversal
+ *
+ * Children of an interior node are stored next to each other starting
+ * at \c offset. Leaves reference the range [offset, offset + primitiveCount)
+ * of the reordered primitive array; \c offset is a multiple of the triangle
+ * block width, so the leaf also covers whole \ref TriangleBlock entries. \c axis is the split axis of a BVH
+ * node, or the mask of occupied octants of an octree node. Two nodes
+ * share a cache line.
+ */
+struct LinearNode {
     BoundingBox3f box;
-    uint32_t childIndexStart = -1, childSize = -1;
-    std::vector<uint32_t> triangle_indices;
-    std::vector<uint32_t> mesh_indices;
+    uint32_t offset;
+    uint16_t primitiveCount;
+    uint8_t childCount;
+    uint8_t axis;
+};
+
+static_assert(sizeof(LinearNode) == 32, "LinearNode should be 32 bytes");
+
+/**
+ * \brief Node of the 4-wide BVH (see \ref EBVH4)
+ *
+ * The bounds of all children are stored together so that they are culled
+ * with a single slab test. Lane \c i < \c childCount is an interior child
+ * if \c primitiveCount[i] is zero, and \c offset[i] then indexes the wide
+ * node array. Otherwise it is a leaf covering the primitive range
+ * [offset[i], offset[i] + primitiveCount[i]), as for \ref LinearNode.
+ */
+struct WideNode {
+    BoundingBox4 bounds;
+    uint32_t offset[4];
+    uint16_t primitiveCount[4];
+    uint32_t childCount = 0;
+};
+
+static_assert(sizeof(WideNode) == 128, "WideNode should be 128 bytes");
+
+/// Entry of the primitive array referenced by the leaves (padding entries hold -1)
+struct PrimitiveIndex {
+    uint32_t triangle_index;
+    uint32_t mesh_index;
+};
+
+/// Triangle reference used while building the BVH (bounds and centroid are cached)
+struct PrimitiveRef {
+    BoundingBox3f box;
+    Point3f centroid;
+    uint32_t triangle_index;
+    uint32_t mesh_index;
+};
+
+/// Summary of a built tree, printed after \ref Accel::build()
+struct AccelStatistics {
+    uint32_t nodeCount = 0;
+    uint32_t leafCount = 0;
+    uint32_t primitiveCount = 0;
+    uint32_t maxDepth = 0;
+    size_t memory = 0;
+    /// Leaf sizes bucketed by powers of two: 0, 1, 2, 3-4, 5-8, 9-16, 17-32, 33+
+    uint32_t leafSizes[8] = {};
+
+    void addLeaf(uint32_t size);
+    std::string toString() const;
+};
+
+/**
+ * \brief Arrays used during traversal
+ *
+ * They point into the vectors filled by \ref Accel::build(), into the
+ * arrays of another accel over the same geometry, or straight into a
+ * memory-mapped cache file.
+ */
+struct AccelData {
+    const LinearNode* nodes = nullptr;
+    const WideNode* wideNodes = nullptr;
+    const PrimitiveIndex* primitives = nullptr;
+    const TriangleBlock* blocks = nullptr;
+    uint32_t nodeCount = 0;
+    uint32_t wideNodeCount = 0;
+    uint32_t primitiveCount = 0;
+    uint32_t blockCount = 0;
+};
+
+/// Arrays of an accel, shared by accels over the same geometry (see \ref ResourceCache)
+struct AccelArrays {
+    /// Arrays of a built accel
+    std::vector<LinearNode> nodes;
+    std::vector<WideNode> wideNodes;
+    std::vector<PrimitiveIndex> primitives;
+    std::vector<TriangleBlock> blocks;
+    /// Cache file the arrays are mapped from instead (see \ref Accel::setCacheFile())
+    std::unique_ptr<MappedFile> file;
+    /// Traversal view of the vectors or of the file
+    AccelData data;
+};
+
+/// Spatial subdivision used by \ref Accel
+enum EAccelType {
+    EOctree = 0,
+    EBVH,
+    /// Binary BVH collapsed into 4-wide nodes
+    EBVH4
 };
 
 static constexpr int MAX_RECURSIVE_DEPTH = 12;
 static constexpr int MAX_TRIANGLES_PER_NODE = 10;
 
+static constexpr int BVH_BIN_COUNT = 16;
+static constexpr int BVH_MAX_DEPTH = 64;
+static constexpr int BVH_MAX_TRIANGLES_PER_LEAF = 8;
+/// Cost of visiting an interior node relative to one ray-triangle test
+static constexpr float BVH_TRAVERSAL_COST = 1.0f;
+/// Ranges with at least this many primitives compute their bounds and bins in parallel
+static constexpr uint32_t BVH_PARALLEL_BINNING_THRESHOLD = 1 << 16;
+/// Subtrees with at least this many primitives build their children as separate tasks
+static constexpr uint32_t BVH_PARALLEL_BUILD_THRESHOLD = 1 << 12;
+static constexpr uint32_t BVH_PARALLEL_GRAIN_SIZE = 1 << 12;
+
+/// Size of the fixed traversal stack (wide BVH nodes push up to 3 extra entries per level)
+static constexpr int ACCEL_STACK_SIZE = 256;
+
 class Accel {
 public:
+    Accel(EAccelType type = EBVH) : m_type(type) {}
+    ~Accel();
+
     void addMesh(Mesh* mesh);
 
+    /**
+     * \brief Cache the built structure in the given file
+     *
+     * \ref build() maps the file instead of building when it was written
+     * for the same meshes and build settings, and (re)writes it otherwise.
+     */
+    void setCacheFile(const std::string& filename) { m_cacheFile = filename; }
+
+    /// Build the structure, or reuse one built over the same meshes (see \ref ResourceCache)
     void build();
     const BoundingBox3f &getBoundingBox() const { return m_bbox; }
+    AccelStatistics getStatistics() const;
+
+    bool rayIntersect(const Ray3f& ray, Intersection& its, bool shadowRay = false) const;
 
-    bool rayIntersect(const Ray3f& ray, Intersection& its, bool shadowRay) const;
+    /**
+     * \brief Any-hit query: is there any triangle on [ray.mint, ray.maxt]?
+     *
+     * Traversal stops at the first intersection that is found and no
+     * hit record is filled in.
+     */
+    bool occluded(const Ray3f& ray) const;
 private:
     std::vector<Mesh *> m_meshes;
     BoundingBox3f m_bbox;
-    Node* m_root;
-    std::vector<FlatNode> m_flattenedNodes;
-    int amount = 0;
+    std::vector<LinearNode> m_nodes;
+    std::vector<PrimitiveIndex> m_primitives;
+    /// Precomputed triangles, lane \c j of block \c i is \c m_primitives[i * width + j]
+    std::vector<TriangleBlock> m_blocks;
+    std::vector<WideNode> m_wideNodes;
+    AccelData m_data;
+    std::string m_cacheFile;
+    std::unique_ptr<MappedFile> m_cache;
+    std::shared_ptr<const AccelArrays> m_shared;
+    EAccelType m_type;
+    std::atomic<int> amount { 0 };
 
-    bool intersectIterative(Ray3f& ray, Intersection& its, bool shadowRay, uint32_t& hit_index) const;
+    template <bool anyHit>
+    bool intersectIterative(Ray3f& ray, Intersection* its, uint32_t& hit_index) const;
+    template <bool anyHit>
+    bool intersectWide(Ray3f& ray, Intersection* its, uint32_t& hit_index) const;
+    template <bool anyHit>
+    bool intersectLeaf(uint32_t offset, uint32_t primitiveCount, const TriangleBlockRay& blockRay,
+                       Ray3f& ray, Intersection* its, uint32_t& hit_index) const;
 
-    bool intersectRecursive(const Node &node, Ray3f& ray, Intersection& its, bool shadowRay, uint32_t& hit_index) const;
     Node* build(BoundingBox3f& box, std::vector<uint32_t>& triangle_indices,
                 std::vector<uint32_t>& mesh_indices, int recursiveDepth = 0);
+    Node* buildBVH(std::vector<PrimitiveRef>& primitives, uint32_t start, uint32_t end, int depth = 0);
+
+    void collectStatistics(uint32_t index, uint32_t depth, AccelStatistics& stats) const;
+    void collectWideStatistics(uint32_t index, uint32_t depth, AccelStatistics& stats) const;
+
+    /// Traverse arrays built by another accel
+    void useSharedArrays(const std::shared_ptr<const AccelArrays>& arrays);
+
+    void flattenTree(const Node* root);
+    void flattenNode(const Node* node, uint32_t index);
+    void flattenWideNode(const Node* node, uint32_t index);
+    uint32_t appendLeaf(const Node* node);
+    void buildTriangleBlocks();
 
-    void flattenTree();
+    uint64_t computeCacheHash() const;
+    bool loadCache();
+    void saveCache() const;
 };
 
 std::vector<BoundingBox3f> subdivideBox(BoundingBox3f& parent);
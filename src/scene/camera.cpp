@@ -3,6 +3,7 @@
 //
 
 #include "camera.h"
+#include "utils/stats.h"
 #include <Eigen/Geometry>
 
 LUMINA_NAMESPACE_BEGIN
@@ -59,6 +60,8 @@ PerspectiveCamera::PerspectiveCamera(const PropertyList& propsList) {
     Color3f PerspectiveCamera::sampleRay(Ray3f &ray,
                       const Point2f &samplePosition,
                       const Point2f &apertureSample) const {
+        Statistics::count(ECameraRays);
+
         /* Compute the corresponding position on the
            near plane (in local camera space) */
         Point3f nearP = m_sampleToCamera * Point3f(
@@ -0,0 +1,389 @@
+//
+// Created by agent on 10/18/26.
+//
+
+#include "lightSampler.h"
+#include "utils/lowDiscrepancy.h"
+#include "utils/timer.h"
+
+#include <Eigen/Geometry>
+
+LUMINA_NAMESPACE_BEGIN
+
+/// Number of candidate split positions per axis when building the light BVH
+#define LIGHT_BVH_BUCKETS 12
+
+/// From this depth on, nodes are split in the middle instead of by the SAH
+#define LIGHT_BVH_MAX_DEPTH 48
+
+/// Deepest possible leaf, so that the bit trails fit into 64 bits and never equal the all-ones sentinel
+#define LIGHT_BVH_MAX_TRAIL_DEPTH 63
+
+namespace {
+    float safeSqrt(float value) { return std::sqrt(std::max(value, 0.0f)); }
+    float safeAcos(float value) { return std::acos(std::min(std::max(value, -1.0f), 1.0f)); }
+
+    /// Smallest k with 2^k >= count
+    int ceilLog2(size_t count) {
+        int k = 0;
+        while (((size_t) 1 << k) < count)
+            k++;
+        return k;
+    }
+
+    /// Angle between two unit vectors, accurate for nearly (anti)parallel ones
+    float angleBetween(const Vector3f& a, const Vector3f& b) {
+        if (a.dot(b) < 0)
+            return M_PI - 2 * std::asin(std::min((a + b).norm() / 2, 1.0f));
+        return 2 * std::asin(std::min((b - a).norm() / 2, 1.0f));
+    }
+
+    /// cos(max(0, a - b)) from the sines and cosines of a and b
+    float cosSubClamped(float sinA, float cosA, float sinB, float cosB) {
+        if (cosA > cosB)
+            return 1.0f;
+        return cosA * cosB + sinA * sinB;
+    }
+
+    /// sin(max(0, a - b)) from the sines and cosines of a and b
+    float sinSubClamped(float sinA, float cosA, float sinB, float cosB) {
+        if (cosA > cosB)
+            return 0.0f;
+        return sinA * cosB - cosA * sinB;
+    }
+}
+
+float LightBounds::importance(const Point3f &p, const Normal3f &n) const {
+    Point3f center = bounds.getCenter();
+    Vector3f diagonal = bounds.max - bounds.min;
+
+    /* Clamp the distance to the size of the bounds, which is inside or near them */
+    float d2 = std::max((p - center).squaredNorm(), std::max(diagonal.norm() / 2, Epsilon * Epsilon));
+    Vector3f wi = (p - center).normalized();
+
+    /* Angle between the axis of the normals and the direction to p */
+    float cosThetaW = w.dot(wi);
+    float sinThetaW = safeSqrt(1 - cosThetaW * cosThetaW);
+
+    /* Half-angle of the cone of directions from p towards the bounds */
+    float radius2 = diagonal.squaredNorm() / 4;
+    float cosThetaB = -1.0f;
+    if ((p - center).squaredNorm() > radius2)
+        cosThetaB = safeSqrt(1 - radius2 / (p - center).squaredNorm());
+    float sinThetaB = safeSqrt(1 - cosThetaB * cosThetaB);
+
+    /* Smallest angle between a normal and a direction from the bounds to p */
+    float sinThetaO = safeSqrt(1 - cosThetaO * cosThetaO);
+    float cosThetaX = cosSubClamped(sinThetaW, cosThetaW, sinThetaO, cosThetaO);
+    float sinThetaX = sinSubClamped(sinThetaW, cosThetaW, sinThetaO, cosThetaO);
+    float cosThetaP = cosSubClamped(sinThetaX, cosThetaX, sinThetaB, cosThetaB);
+    if (cosThetaP <= cosThetaE)
+        return 0.0f;
+
+    float result = phi * cosThetaP / d2;
+
+    /* Smallest angle at the receiver */
+    if (n.squaredNorm() > 0) {
+        float cosThetaI = std::abs(wi.dot(n));
+        float sinThetaI = safeSqrt(1 - cosThetaI * cosThetaI);
+        result *= cosSubClamped(sinThetaI, cosThetaI, sinThetaB, cosThetaB);
+    }
+
+    return std::max(result, 0.0f);
+}
+
+LightBounds LightBounds::merge(const LightBounds &a, const LightBounds &b) {
+    if (a.phi == 0)
+        return b;
+    if (b.phi == 0)
+        return a;
+
+    LightBounds result;
+    result.bounds = BoundingBox3f::merge(a.bounds, b.bounds);
+    result.phi = a.phi + b.phi;
+    result.cosThetaE = std::min(a.cosThetaE, b.cosThetaE);
+
+    /* Smallest cone containing both cones of normals */
+    result.w = a.w;
+    result.cosThetaO = -1.0f;
+    if (a.cosThetaO == -1.0f || b.cosThetaO == -1.0f)
+        return result;
+
+    float thetaA = safeAcos(a.cosThetaO), thetaB = safeAcos(b.cosThetaO);
+    float thetaD = angleBetween(a.w, b.w);
+    if (std::min(thetaD + thetaB, M_PI) <= thetaA) {
+        result.cosThetaO = a.cosThetaO;
+        return result;
+    }
+    if (std::min(thetaD + thetaA, M_PI) <= thetaB) {
+        result.w = b.w;
+        result.cosThetaO = b.cosThetaO;
+        return result;
+    }
+
+    float thetaO = (thetaA + thetaD + thetaB) / 2;
+    Vector3f axis = a.w.cross(b.w);
+    if (thetaO >= M_PI || axis.squaredNorm() == 0)
+        return result;
+
+    result.w = (Eigen::AngleAxisf(thetaO - thetaA, axis.normalized()) * a.w).normalized();
+    result.cosThetaO = std::cos(thetaO);
+    return result;
+}
+
+void LightSampler::build(const std::vector<Emitter *> &emitters, const BoundingBox3f &sceneBounds) {
+    m_emitters = emitters;
+    m_indices.clear();
+    for (uint32_t i = 0; i < (uint32_t) emitters.size(); i++)
+        m_indices[emitters[i]] = i;
+
+    m_power.clear();
+    m_nodes.clear();
+    m_infinite.clear();
+    m_bitTrails.assign(emitters.size(), (uint64_t) -1);
+
+    if (m_type == EPower) {
+        /* Lights without bounds cover the scene */
+        float sceneRadius = sceneBounds.isValid() ? (sceneBounds.max - sceneBounds.min).norm() / 2 : 1.0f;
+
+        for (Emitter* emitter : emitters) {
+            LightBounds bounds;
+            if (emitter->getLightBounds(bounds))
+                m_power.append(bounds.phi);
+            else
+                m_power.append(emitter->getRadiance().getLuminance() * M_PI * sceneRadius * sceneRadius);
+        }
+
+        /* Fall back to uniform probabilities if no emitter has any power */
+        if (m_power.normalize() == 0) {
+            m_power.clear();
+            for (size_t i = 0; i < emitters.size(); i++)
+                m_power.append(1.0f);
+            m_power.normalize();
+        }
+    } else if (m_type == EBVH) {
+        std::vector<BVHLight> lights;
+        for (uint32_t i = 0; i < (uint32_t) emitters.size(); i++) {
+            LightBounds bounds;
+            if (!emitters[i]->getLightBounds(bounds))
+                m_infinite.push_back(i);
+            else if (bounds.phi > 0)
+                lights.push_back({ i, bounds });
+        }
+
+        std::cout << "Building light BVH over " << lights.size() << " emitters...";
+        std::cout.flush();
+        Timer timer;
+
+        if (!lights.empty())
+            buildRecursive(lights, 0, lights.size(), 0, 0);
+
+        std::cout << "done. (" << m_nodes.size() << " nodes, took " << timer.elapsedString() << ")" << std::endl;
+    }
+}
+
+void LightSampler::buildRecursive(std::vector<BVHLight> &lights, size_t begin, size_t end, uint64_t bitTrail, int depth) {
+    if (end - begin == 1) {
+        m_nodes.push_back({ lights[begin].bounds, lights[begin].emitter, true });
+        m_bitTrails[lights[begin].emitter] = bitTrail;
+        return;
+    }
+
+    LightBounds bounds;
+    BoundingBox3f centroidBounds;
+    for (size_t i = begin; i < end; i++) {
+        bounds = LightBounds::merge(bounds, lights[i].bounds);
+        centroidBounds.expandBy(lights[i].bounds.bounds.getCenter());
+    }
+
+    /* Choose the bucket boundary with the lowest cost along any axis */
+    float minCost = Infinity;
+    int minAxis = -1, minBucket = -1;
+    auto getBucket = [&](const BVHLight& light, int axis) {
+        float offset = (light.bounds.bounds.getCenter()[axis] - centroidBounds.min[axis]) /
+                       (centroidBounds.max[axis] - centroidBounds.min[axis]);
+        return std::min(std::max((int) (offset * LIGHT_BVH_BUCKETS), 0), LIGHT_BVH_BUCKETS - 1);
+    };
+
+    /* Splitting in the middle puts the leaves of this subtree at most ceilLog2(count) levels
+       further down. Switch to it early enough that no leaf ends up below LIGHT_BVH_MAX_TRAIL_DEPTH,
+       no matter how many lights coincide or how unbalanced the SAH splits above were */
+    bool useSAH = depth < LIGHT_BVH_MAX_DEPTH && depth + ceilLog2(end - begin) < LIGHT_BVH_MAX_TRAIL_DEPTH;
+
+    for (int axis = 0; axis < 3 && useSAH; axis++) {
+        if (centroidBounds.max[axis] == centroidBounds.min[axis])
+            continue;
+
+        LightBounds buckets[LIGHT_BVH_BUCKETS];
+        for (size_t i = begin; i < end; i++) {
+            int bucket = getBucket(lights[i], axis);
+            buckets[bucket] = LightBounds::merge(buckets[bucket], lights[i].bounds);
+        }
+
+        for (int split = 0; split < LIGHT_BVH_BUCKETS - 1; split++) {
+            LightBounds below, above;
+            for (int i = 0; i <= split; i++)
+                below = LightBounds::merge(below, buckets[i]);
+            for (int i = split + 1; i < LIGHT_BVH_BUCKETS; i++)
+                above = LightBounds::merge(above, buckets[i]);
+
+            float cost = evaluateCost(below, bounds.bounds, axis) + evaluateCost(above, bounds.bounds, axis);
+            if (cost > 0 && cost < minCost) {
+                minCost = cost;
+                minAxis = axis;
+                minBucket = split;
+            }
+        }
+    }
+
+    size_t middle = begin;
+    if (minAxis != -1) {
+        middle = std::partition(lights.begin() + begin, lights.begin() + end, [&](const BVHLight& light) {
+            return getBucket(light, minAxis) <= minBucket;
+        }) - lights.begin();
+    }
+
+    if (middle == begin || middle == end) {
+        /* Split in the middle of the largest axis instead */
+        int axis = centroidBounds.getLargestAxis();
+        middle = (begin + end) / 2;
+        std::nth_element(lights.begin() + begin, lights.begin() + middle, lights.begin() + end,
+                         [&](const BVHLight& a, const BVHLight& b) {
+                             return a.bounds.bounds.getCenter()[axis] < b.bounds.bounds.getCenter()[axis];
+                         });
+    }
+
+    uint32_t index = (uint32_t) m_nodes.size();
+    m_nodes.push_back({ bounds, 0, false });
+    buildRecursive(lights, begin, middle, bitTrail, depth + 1);
+    m_nodes[index].index = (uint32_t) m_nodes.size();
+    buildRecursive(lights, middle, end, bitTrail | ((uint64_t) 1 << depth), depth + 1);
+}
+
+float LightSampler::evaluateCost(const LightBounds &bounds, const BoundingBox3f &nodeBounds, int axis) {
+    if (bounds.phi == 0)
+        return 0.0f;
+
+    /* Solid angle measure of the cone of normals widened by the emission angle */
+    float thetaO = safeAcos(bounds.cosThetaO), thetaE = safeAcos(bounds.cosThetaE);
+    float thetaW = std::min(thetaO + thetaE, M_PI);
+    float sinThetaO = safeSqrt(1 - bounds.cosThetaO * bounds.cosThetaO);
+    float solidAngle = 2 * M_PI * (1 - bounds.cosThetaO) +
+                       M_PI / 2 * (2 * thetaW * sinThetaO - std::cos(thetaO - 2 * thetaW) -
+                                   2 * thetaO * sinThetaO + bounds.cosThetaO);
+
+    /* Penalize thin slabs */
+    Vector3f diagonal = nodeBounds.max - nodeBounds.min;
+    float regularity = diagonal.maxCoeff() / diagonal[axis];
+
+    return bounds.phi * solidAngle * regularity * bounds.bounds.getSurfaceArea();
+}
+
+Emitter *LightSampler::sample(const Point3f &p, const Normal3f &n, float sample, float &pdf) const {
+    pdf = 0.0f;
+    if (m_emitters.empty())
+        return nullptr;
+
+    if (m_type == EUniform) {
+        size_t index = std::min((size_t) (sample * m_emitters.size()), m_emitters.size() - 1);
+        pdf = 1.0f / m_emitters.size();
+        return m_emitters[index];
+    }
+
+    if (m_type == EPower) {
+        size_t index = m_power.sample(sample, pdf);
+        return pdf > 0 ? m_emitters[index] : nullptr;
+    }
+
+    /* Lights without bounds are chosen like one more child of the root */
+    float infiniteProbability = (float) m_infinite.size() / (m_infinite.size() + (m_nodes.empty() ? 0 : 1));
+    if (sample < infiniteProbability) {
+        size_t index = std::min((size_t) (sample / infiniteProbability * m_infinite.size()), m_infinite.size() - 1);
+        pdf = infiniteProbability / m_infinite.size();
+        return m_emitters[m_infinite[index]];
+    }
+    if (m_nodes.empty())
+        return nullptr;
+
+    sample = std::min((sample - infiniteProbability) / (1 - infiniteProbability), LUMINA_ONE_MINUS_EPSILON);
+    float probability = 1 - infiniteProbability;
+    uint32_t nodeIndex = 0;
+
+    while (true) {
+        const Node& node = m_nodes[nodeIndex];
+        if (node.isLeaf) {
+            if (nodeIndex > 0 || node.bounds.importance(p, n) > 0) {
+                pdf = probability;
+                return m_emitters[node.index];
+            }
+            return nullptr;
+        }
+
+        float importance0 = m_nodes[nodeIndex + 1].bounds.importance(p, n);
+        float importance1 = m_nodes[node.index].bounds.importance(p, n);
+        if (importance0 == 0 && importance1 == 0)
+            return nullptr;
+
+        float probability0 = importance0 / (importance0 + importance1);
+        if (sample < probability0) {
+            nodeIndex = nodeIndex + 1;
+            sample = std::min(sample / probability0, LUMINA_ONE_MINUS_EPSILON);
+            probability *= probability0;
+        } else {
+            nodeIndex = node.index;
+            sample = std::min((sample - probability0) / (1 - probability0), LUMINA_ONE_MINUS_EPSILON);
+            probability *= 1 - probability0;
+        }
+    }
+}
+
+float LightSampler::pdf(const Point3f &p, const Normal3f &n, const Emitter *emitter) const {
+    auto it = m_indices.find(emitter);
+    if (it == m_indices.end())
+        return 0.0f;
+
+    if (m_type == EUniform)
+        return 1.0f / m_emitters.size();
+    if (m_type == EPower)
+        return m_power[it->second];
+
+    float infiniteProbability = (float) m_infinite.size() / (m_infinite.size() + (m_nodes.empty() ? 0 : 1));
+    uint64_t bitTrail = m_bitTrails[it->second];
+    if (bitTrail == (uint64_t) -1) {
+        /* Either a light without bounds or one without power */
+        LightBounds bounds;
+        return emitter->getLightBounds(bounds) ? 0.0f : infiniteProbability / m_infinite.size();
+    }
+
+    float probability = 1 - infiniteProbability;
+    uint32_t nodeIndex = 0;
+
+    while (true) {
+        const Node& node = m_nodes[nodeIndex];
+        if (node.isLeaf)
+            return nodeIndex > 0 || node.bounds.importance(p, n) > 0 ? probability : 0.0f;
+
+        float importance0 = m_nodes[nodeIndex + 1].bounds.importance(p, n);
+        float importance1 = m_nodes[node.index].bounds.importance(p, n);
+        if (importance0 == 0 && importance1 == 0)
+            return 0.0f;
+
+        float probability0 = importance0 / (importance0 + importance1);
+        if (bitTrail & 1) {
+            nodeIndex = node.index;
+            probability *= 1 - probability0;
+        } else {
+            nodeIndex = nodeIndex + 1;
+            probability *= probability0;
+        }
+        bitTrail >>= 1;
+    }
+}
+
+std::string LightSampler::toString() const {
+    return tfm::format("LightSampler[type=%s, emitters=%i, nodes=%i]",
+                       m_type == EUniform ? "uniform" : m_type == EPower ? "power" : "bvh",
+                       m_emitters.size(), m_nodes.size());
+}
+
+LUMINA_NAMESPACE_END
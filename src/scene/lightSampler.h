@@ -0,0 +1,92 @@
+//
+// Created by agent on 10/18/26.
+//
+
+#pragma once
+
+#include "lights/emitter.h"
+#include "utils/dpdf.h"
+
+#include <unordered_map>
+
+LUMINA_NAMESPACE_BEGIN
+
+/**
+ * \brief Chooses the emitter that a shading point samples
+ *
+ * - \c EUniform picks every emitter with the same probability.
+ * - \c EPower picks them proportionally to their power.
+ * - \c EBVH builds a bounding volume hierarchy over the \ref LightBounds
+ *   of the emitters, and descends it choosing each child proportionally
+ *   to its estimated contribution to the shading point, which accounts
+ *   for power, distance and orientation ("Importance Sampling of Many
+ *   Lights with Adaptive Tree Splitting", Conty Estevez and Kulla 2018).
+ *   Lights without bounds (directional lights) are picked uniformly with
+ *   a probability proportional to their number.
+ *
+ * \ref pdf() returns the exact probability of \ref sample() for use in
+ * multiple importance sampling.
+ */
+class LightSampler {
+public:
+    enum EType {
+        EUniform,
+        EPower,
+        EBVH
+    };
+
+    explicit LightSampler(EType type = EBVH) : m_type(type) { }
+
+    /// Prepare to sample the given emitters, \c sceneBounds sizes the power of lights without bounds
+    void build(const std::vector<Emitter*>& emitters, const BoundingBox3f& sceneBounds);
+
+    /**
+     * \brief Choose an emitter for a shading point
+     *
+     * \param n
+     *     Shading normal at \c p, or zero
+     * \return
+     *     The emitter and its probability in \c pdf, or \c nullptr if no
+     *     emitter can contribute to \c p
+     */
+    Emitter* sample(const Point3f& p, const Normal3f& n, float sample, float& pdf) const;
+
+    /// Probability that \ref sample() chooses \c emitter for the shading point
+    float pdf(const Point3f& p, const Normal3f& n, const Emitter* emitter) const;
+
+    EType getType() const { return m_type; }
+
+    std::string toString() const;
+private:
+    struct Node {
+        LightBounds bounds;
+        /// Index of the emitter for leaves, of the second child otherwise (the first one follows the node)
+        uint32_t index;
+        bool isLeaf;
+    };
+
+    struct BVHLight {
+        uint32_t emitter;
+        LightBounds bounds;
+    };
+
+    void buildRecursive(std::vector<BVHLight>& lights, size_t begin, size_t end, uint64_t bitTrail, int depth);
+
+    /// Cost of a node with the given bounds for a split along \c axis of \c centroidBounds
+    static float evaluateCost(const LightBounds& bounds, const BoundingBox3f& centroidBounds, int axis);
+
+    EType m_type;
+    std::vector<Emitter*> m_emitters;
+    std::unordered_map<const Emitter*, uint32_t> m_indices;
+
+    /// Distribution of \c EPower
+    DiscretePDF m_power;
+
+    /// Hierarchy of \c EBVH, and the lights outside of it
+    std::vector<Node> m_nodes;
+    std::vector<uint32_t> m_infinite;
+    /// Per emitter, the branches taken from the root to its leaf (bit i for depth i), or -1 for infinite ones
+    std::vector<uint64_t> m_bitTrails;
+};
+
+LUMINA_NAMESPACE_END
@@ -0,0 +1,97 @@
+//
+// Created by agent on 10/18/26.
+//
+
+#pragma once
+
+#include "primitives/ray.h"
+#include "primitives/bbox.h"
+
+LUMINA_NAMESPACE_BEGIN
+
+/// Number of cells along every axis of the grid that ray origins are binned into (a power of two)
+#define LUMINA_RAY_SORT_GRID 512
+
+/**
+ * \brief Reorders batches of rays so that consecutive rays traverse similar parts of the scene
+ *
+ * The sort key of a ray is the octant of its direction followed by the
+ * Morton code of the grid cell containing its origin. Rays with nearby
+ * origins heading the same general way visit mostly the same nodes and
+ * triangles, which then stay in the caches while they are traced.
+ */
+class RaySorter {
+public:
+    /// Create a sorter for rays starting within the given bounds (usually the scene's)
+    explicit RaySorter(const BoundingBox3f& bounds) : m_min(bounds.min) {
+        Vector3f extents = (bounds.max - bounds.min).cwiseMax(Vector3f::Constant(Epsilon));
+        m_scale = Vector3f::Constant((float) LUMINA_RAY_SORT_GRID).cwiseQuotient(extents);
+    }
+
+    uint32_t getKey(const Ray3f& ray) const {
+        uint32_t octant = (ray.d.x() < 0 ? 1u : 0u) | (ray.d.y() < 0 ? 2u : 0u) | (ray.d.z() < 0 ? 4u : 0u);
+
+        Vector3f cell = (ray.o - m_min).cwiseProduct(m_scale);
+        auto coordinate = [](float value) {
+            return (uint32_t) std::min(std::max(value, 0.0f), (float) (LUMINA_RAY_SORT_GRID - 1));
+        };
+
+        return (octant << 27) | spread(coordinate(cell.x())) | (spread(coordinate(cell.y())) << 1) |
+               (spread(coordinate(cell.z())) << 2);
+    }
+
+    /**
+     * \brief Sort items by the key of the ray returned by \c getRay(item)
+     *
+     * This is a stable radix sort, linear in the number of items.
+     */
+    template <typename T, typename GetRay> void sort(std::vector<T>& items, const GetRay& getRay) {
+        if (items.size() < 2)
+            return;
+
+        m_entries.resize(items.size());
+        m_scratch.resize(items.size());
+        for (size_t i = 0; i < items.size(); i++)
+            m_entries[i] = { getKey(getRay(items[i])), (uint32_t) i };
+
+        /* Three passes over 10 bits each cover the 30-bit keys */
+        for (int shift = 0; shift < 30; shift += 10) {
+            uint32_t offsets[1025] = {};
+            for (const Entry& entry : m_entries)
+                offsets[((entry.key >> shift) & 1023) + 1]++;
+            for (int i = 1; i < 1025; i++)
+                offsets[i] += offsets[i - 1];
+            for (const Entry& entry : m_entries)
+                m_scratch[offsets[(entry.key >> shift) & 1023]++] = entry;
+            m_entries.swap(m_scratch);
+        }
+
+        std::vector<T> sorted;
+        sorted.reserve(items.size());
+        for (const Entry& entry : m_entries)
+            sorted.push_back(std::move(items[entry.index]));
+        items.swap(sorted);
+    }
+private:
+    struct Entry {
+        uint32_t key;
+        uint32_t index;
+    };
+
+    /// Insert two zero bits between each of the lower 10 bits
+    static uint32_t spread(uint32_t v) {
+        v &= 0x000003ff;
+        v = (v | (v << 16)) & 0x030000ff;
+        v = (v | (v << 8)) & 0x0300f00f;
+        v = (v | (v << 4)) & 0x030c30c3;
+        v = (v | (v << 2)) & 0x09249249;
+        return v;
+    }
+
+    Point3f m_min;
+    Vector3f m_scale;
+    /* Reused between batches */
+    std::vector<Entry> m_entries, m_scratch;
+};
+
+LUMINA_NAMESPACE_END
@@ -3,11 +3,38 @@
 //
 
 #include "scene.h"
+#include "lights/areaLight.h"
+#include "utils/stats.h"
 
 LUMINA_NAMESPACE_BEGIN
 
-Scene::Scene(const PropertyList &) {
-    m_accel = new Accel();
+Scene::Scene(const PropertyList &propsList) {
+    std::string accelType = toLower(propsList.getString("accel", "bvh"));
+
+    if (accelType == "bvh")
+        m_accel = new Accel(EBVH);
+    else if (accelType == "bvh4")
+        m_accel = new Accel(EBVH4);
+    else if (accelType == "octree")
+        m_accel = new Accel(EOctree);
+    else
+        throw LuminaException("Unknown acceleration structure \"%s\", expected \"bvh\", \"bvh4\" or \"octree\"", accelType);
+
+    /* Relative cache paths are placed next to the scene file */
+    std::string accelCache = propsList.getString("accelCache", "");
+    if (!accelCache.empty())
+        m_accel->setCacheFile(((*getFileResolver())[0] / accelCache).string());
+
+    std::string lightSamplerType = toLower(propsList.getString("lightSampler", "bvh"));
+
+    if (lightSamplerType == "uniform")
+        m_lightSampler = LightSampler(LightSampler::EUniform);
+    else if (lightSamplerType == "power")
+        m_lightSampler = LightSampler(LightSampler::EPower);
+    else if (lightSamplerType == "bvh")
+        m_lightSampler = LightSampler(LightSampler::EBVH);
+    else
+        throw LuminaException("Unknown light sampler \"%s\", expected \"uniform\", \"power\" or \"bvh\"", lightSamplerType);
 }
 
 Scene::~Scene() {
@@ -19,6 +46,8 @@ Scene::~Scene() {
 
 void Scene::activate() {
     m_accel->build();
+    buildLightTable();
+    m_lightSampler.build(m_lightTable, m_accel->getBoundingBox());
 
     if (!m_integrator)
         throw LuminaException("No integrator was specified.");
@@ -36,6 +65,37 @@ void Scene::activate() {
     std::cout << std::endl;
 }
 
+void Scene::buildLightTable() {
+    m_lightTable.clear();
+    m_triangleLights.clear();
+    m_meshLights.clear();
+
+    std::vector<Emitter*> others;
+    for (Emitter* emitter : m_emitters) {
+        Mesh* mesh = emitter->getMesh();
+        if (!mesh || !dynamic_cast<AreaLight*>(emitter)) {
+            others.push_back(emitter);
+            continue;
+        }
+
+        /* Degenerate triangles stay in the table, which keeps it indexed by triangle, but are never chosen */
+        m_meshLights[mesh] = (uint32_t) m_lightTable.size();
+        for (uint32_t i = 0; i < mesh->getTriangleCount(); i++) {
+            m_triangleLights.push_back(std::make_unique<TriangleLight>(emitter, mesh, i));
+            m_lightTable.push_back(m_triangleLights.back().get());
+        }
+    }
+
+    m_lightTable.insert(m_lightTable.end(), others.begin(), others.end());
+}
+
+Emitter *Scene::getLight(const Intersection &its) const {
+    auto it = m_meshLights.find(its.mesh);
+    if (it == m_meshLights.end())
+        return its.mesh->getEmitter();
+    return m_lightTable[it->second + its.triangle];
+}
+
 void Scene::addChild(LuminaObject *obj) {
     switch(obj->getClassType()) {
         case EMesh: {
@@ -105,20 +165,18 @@ std::string Scene::toString() const {
 }
 
 bool Scene::rayIntersect(const Ray3f &ray, Intersection &its) const {
+    Statistics::count(EIntersectionRays);
     return m_accel->rayIntersect(ray, its, false);
 }
 
 bool Scene::rayIntersect(const Ray3f &ray) const {
-    Intersection its;
-
-    return m_accel->rayIntersect(ray, its, true);
+    Statistics::count(EShadowRays);
+    return m_accel->occluded(ray);
 }
 
-Emitter *Scene::sampleLight(float sample, float& pdf) const {
-    int index = (int) (sample * m_emitters.size());
-
-    pdf = 1.0f / m_emitters.size();
-    return m_emitters[index];
+bool Scene::occluded(const Ray3f &ray, float tmax) const {
+    Statistics::count(EShadowRays);
+    return m_accel->occluded(Ray3f(ray, ray.mint, tmax));
 }
 
     LUMINA_REGISTER_CLASS(Scene, "scene")
@@ -7,7 +7,9 @@
 #include "core/object.h"
 #include "camera.h"
 #include "lights/emitter.h"
+#include "lights/triangleLight.h"
 #include "accel.h"
+#include "lightSampler.h"
 #include "utils/sampler.h"
 #include "integrators/integrator.h"
 
@@ -15,7 +17,17 @@ LUMINA_NAMESPACE_BEGIN
 
 class Scene : public LuminaObject {
 public:
-    /// Construct a new scene object
+    /**
+     * \brief Construct a new scene object
+     *
+     * The acceleration structure can be chosen with
+     * <tt>&lt;string name="accel" value="bvh|bvh4|octree"/&gt;</tt> (default: bvh)
+     * and cached on disk with <tt>&lt;string name="accelCache" value="scene.accel"/&gt;</tt>
+     * (relative to the scene file, see \ref Accel::setCacheFile()).
+     * The emitter sampled by every shading point is chosen by
+     * <tt>&lt;string name="lightSampler" value="uniform|power|bvh"/&gt;</tt>
+     * (default: bvh, see \ref LightSampler)
+     */
     Scene(const PropertyList &);
 
     /// Release all memory
@@ -46,7 +58,39 @@ public:
     bool rayIntersect(const Ray3f& ray, Intersection& its) const;
     bool rayIntersect(const Ray3f& ray) const;
 
-    Emitter* sampleLight(float sample, float& pdf) const;
+    /**
+     * \brief Shadow ray query: is anything hit between \c ray.mint and \c tmax?
+     *
+     * Stops at the first intersection and skips computing the hit record,
+     * which makes it considerably cheaper than \ref rayIntersect().
+     */
+    bool occluded(const Ray3f& ray, float tmax) const;
+
+    /**
+     * \brief Choose the emitter to sample for a shading point
+     *
+     * \param n
+     *     Shading normal at \c p, or zero to ignore the orientation of the receiver
+     * \return
+     *     The emitter and its selection probability in \c pdf, or \c nullptr
+     *     if no emitter can contribute to \c p
+     */
+    Emitter* sampleLight(const Point3f& p, const Normal3f& n, float sample, float& pdf) const {
+        return m_lightSampler.sample(p, n, sample, pdf);
+    }
+
+    /// Probability that \ref sampleLight() chooses \c emitter for the shading point
+    float pdfLight(const Point3f& p, const Normal3f& n, const Emitter* emitter) const {
+        return m_lightSampler.pdf(p, n, emitter);
+    }
+
+    /**
+     * \brief Return the emitter that \ref sampleLight() would choose to sample a hit on an emissive mesh
+     *
+     * Area lights are split into one \ref TriangleLight per triangle, so this is
+     * the light of the hit triangle rather than the emitter of the mesh.
+     */
+    Emitter* getLight(const Intersection& its) const;
 
     /// \brief Return an axis-aligned box that bounds the scene
     const BoundingBox3f &getBoundingBox() const {
@@ -63,13 +107,23 @@ public:
 
     EClassType getClassType() const { return EScene; }
 private:
+    /// Fill \ref m_lightTable from the emitters of the scene
+    void buildLightTable();
+
     Sampler* m_sampler = nullptr;
     Camera* m_camera = nullptr;
     Integrator* m_integrator = nullptr;
     Accel* m_accel = nullptr;
+    LightSampler m_lightSampler;
 
     std::vector<Mesh *> m_meshes;
     std::vector<Emitter *> m_emitters;
+
+    /// Emitters to sample: every triangle of the area lights, followed by the other emitters
+    std::vector<Emitter *> m_lightTable;
+    std::vector<std::unique_ptr<TriangleLight>> m_triangleLights;
+    /// Position in \ref m_lightTable of the first triangle of every emissive mesh
+    std::unordered_map<const Mesh*, uint32_t> m_meshLights;
 };
 
 LUMINA_NAMESPACE_END
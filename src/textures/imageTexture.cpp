@@ -1,5 +1,6 @@
 #include "imageTexture.h"
 #include "utils/imageIo.h"
+#include "utils/stats.h"
 
 LUMINA_NAMESPACE_BEGIN
 
@@ -50,10 +51,13 @@ template<typename Tmemory, typename Treturn>
 MipMap<Tmemory>* ImageTexture<Tmemory, Treturn>::getTexture(const std::string& filename, 
 	bool doTrilinear, float maxAniso, ImageWrap wrap, float scale, bool gamma)
 {
-	TextureInfo texInfo(filename, doTrilinear, maxAniso, wrap, scale, gamma);
+	/* Textures stay loaded for the whole process, so batch jobs share them. Scenes
+	   in different directories can use the same relative name for different files */
+	TextureInfo texInfo(getFileResolver()->resolve(filename).string(), doTrilinear, maxAniso, wrap, scale, gamma);
 	if (textures.find(texInfo) != textures.end())
 		return textures[texInfo].get();
 
+	StatPhase phase(EPhaseTextureBuild);
 	Point2i resolution;
 	std::unique_ptr<Color3f[]> texels = readImage(filename, resolution);
 	MipMap<Tmemory>* mipmap = nullptr;
@@ -0,0 +1,124 @@
+//
+// Created by agent on 10/18/26.
+//
+
+#include "utils/test.h"
+#include "scene/accel.h"
+#include "primitives/bbox4.h"
+#include "pcg32/pcg32.h"
+
+LUMINA_NAMESPACE_BEGIN
+
+/**
+ * \brief Consistency checks of the ray traversal kernels
+ *
+ * - \ref intersectBoundingBox4() has to accept exactly the boxes that
+ *   \ref BoundingBox3f::rayIntersect() accepts, including for rays that
+ *   start on a box face with an axis-aligned direction (where the slab
+ *   distances are NaN).
+ * - Queries against accels built without any geometry have to terminate
+ *   without a hit, for every accel type.
+ */
+class AccelTest : public Test {
+public:
+    AccelTest(const PropertyList& propsList) {
+        /* Number of random boxes whose faces are used as ray origins */
+        m_boxCount = propsList.getInteger("boxCount", 1000);
+    }
+
+    std::string toString() const {
+        return tfm::format("AccelTest[boxCount = %i]", m_boxCount);
+    }
+
+protected:
+    int run() { return testFaceOrigins() + testEmptyAccels(); }
+
+    std::string getName() const { return "accel"; }
+
+private:
+    /// Compare the two slab tests for rays starting on the faces, edges and corners of random boxes
+    int testFaceOrigins() const {
+        pcg32 random;
+        int failures = 0, rayCount = 0;
+
+        for (int i = 0; i < m_boxCount; i++) {
+            Point3f a(random.nextFloat(), random.nextFloat(), random.nextFloat());
+            Point3f b(random.nextFloat(), random.nextFloat(), random.nextFloat());
+            BoundingBox3f box(a.cwiseMin(b), a.cwiseMax(b));
+
+            /* Lanes hold the box, a flat copy of it and two boxes that are offset along one axis */
+            BoundingBox3f boxes[4] = { box, box, box, box };
+            boxes[1].max.z() = boxes[1].min.z();
+            boxes[2].min.x() += 2.0f; boxes[2].max.x() += 2.0f;
+            boxes[3].min.y() -= 0.5f; boxes[3].max.y() -= 0.5f;
+            BoundingBox4 box4;
+            for (int lane = 0; lane < 4; lane++)
+                box4.set(lane, boxes[lane]);
+
+            /* Origins on the corners, edge midpoints and face centers of the box */
+            for (int corner = 0; corner < 27; corner++) {
+                Point3f o;
+                for (int axis = 0, c = corner; axis < 3; axis++, c /= 3)
+                    o[axis] = c % 3 == 0 ? box.min[axis] : c % 3 == 1 ? box.max[axis] : box.getCenter()[axis];
+
+                /* Axis-aligned directions, the other components being +0 or -0 */
+                for (int axis = 0; axis < 3; axis++) {
+                    for (int sign = 0; sign < 16; sign++) {
+                        Vector3f d(sign & 2 ? -0.0f : 0.0f, sign & 4 ? -0.0f : 0.0f, sign & 8 ? -0.0f : 0.0f);
+                        d[axis] = sign & 1 ? -1.0f : 1.0f;
+                        failures += compare(box4, boxes, Ray3f(o, d));
+                        rayCount++;
+                    }
+                }
+            }
+        }
+
+        std::cout << "Compared the 4-wide slab test on " << rayCount << " rays starting on box faces, "
+                  << failures << " mismatches" << std::endl;
+        return failures;
+    }
+
+    /// Check every lane of the 4-wide test against the scalar one, returns the number of mismatches
+    static int compare(const BoundingBox4& box4, const BoundingBox3f boxes[4], const Ray3f& ray) {
+        float nearT[4];
+        int mask = intersectBoundingBox4(box4, BoundingBox4Ray(ray), ray.mint, ray.maxt, nearT);
+
+        int failures = 0;
+        for (int lane = 0; lane < 4; lane++) {
+            bool expected = boxes[lane].rayIntersect(ray), hit = (mask >> lane) & 1;
+            if (hit == expected)
+                continue;
+
+            std::cout << tfm::format("intersectBoundingBox4() = %i but rayIntersect() = %i for %s and %s",
+                                     (int) hit, (int) expected, boxes[lane].toString(), ray.toString()) << std::endl;
+            failures++;
+        }
+        return failures;
+    }
+
+    /// Query accels without any mesh
+    static int testEmptyAccels() {
+        int failures = 0;
+        const EAccelType types[] = { EOctree, EBVH, EBVH4 };
+
+        for (EAccelType type : types) {
+            Accel accel(type);
+            accel.build();
+
+            Intersection its;
+            Ray3f ray(Point3f(0.0f), Vector3f(0.0f, 0.0f, 1.0f));
+            if (accel.rayIntersect(ray, its) || accel.occluded(ray)) {
+                std::cout << "An empty accel of type " << (int) type << " reported an intersection" << std::endl;
+                failures++;
+            }
+        }
+
+        std::cout << "Queried empty accels, " << failures << " failures" << std::endl;
+        return failures;
+    }
+
+    int m_boxCount;
+};
+
+LUMINA_REGISTER_CLASS(AccelTest, "acceltest")
+LUMINA_NAMESPACE_END
@@ -0,0 +1,259 @@
+//
+// Created by agent on 10/18/26.
+//
+
+#include "utils/test.h"
+#include "bsdfs/bsdf.h"
+#include "primitives/frame.h"
+#include "utils/warp.h"
+#include "pcg32/pcg32.h"
+
+LUMINA_NAMESPACE_BEGIN
+
+namespace {
+    /// Regularized lower incomplete gamma function P(a, x)
+    double incompleteGamma(double a, double x) {
+        if (x <= 0)
+            return 0.0;
+
+        double logPrefix = -x + a * std::log(x) - std::lgamma(a);
+        if (x < a + 1) {
+            /* Series expansion */
+            double term = 1.0 / a, sum = term;
+            for (int n = 1; n < 1000 && std::abs(term) > std::abs(sum) * 1e-15; n++) {
+                term *= x / (a + n);
+                sum += term;
+            }
+            return sum * std::exp(logPrefix);
+        }
+
+        /* Continued fraction of the upper function (modified Lentz) */
+        double b = x + 1 - a, c = 1e300, d = 1 / b, h = d;
+        for (int i = 1; i < 1000; i++) {
+            double an = -i * (i - a);
+            b += 2;
+            d = an * d + b;
+            if (std::abs(d) < 1e-300)
+                d = 1e-300;
+            c = b + an / c;
+            if (std::abs(c) < 1e-300)
+                c = 1e-300;
+            d = 1 / d;
+            h *= d * c;
+            if (std::abs(d * c - 1) < 1e-15)
+                break;
+        }
+        return 1.0 - std::exp(logPrefix) * h;
+    }
+
+    template <typename Func>
+    double simpsonStep(const Func& f, double a, double b, double fa, double fm, double fb, double whole,
+                       double eps, int depth) {
+        double m = (a + b) / 2, lm = (a + m) / 2, rm = (m + b) / 2;
+        double flm = f(lm), frm = f(rm);
+        double left = (m - a) / 6 * (fa + 4 * flm + fm), right = (b - m) / 6 * (fm + 4 * frm + fb);
+        double delta = left + right - whole;
+
+        if (depth <= 0 || std::abs(delta) <= 15 * eps)
+            return left + right + delta / 15;
+        return simpsonStep(f, a, m, fa, flm, fm, left, eps / 2, depth - 1) +
+               simpsonStep(f, m, b, fm, frm, fb, right, eps / 2, depth - 1);
+    }
+
+    /// Integrate \c f over [a, b] with adaptive Simpson quadrature
+    template <typename Func>
+    double adaptiveSimpson(const Func& f, double a, double b, double eps = 1e-6, int depth = 6) {
+        double fa = f(a), fm = f((a + b) / 2), fb = f(b);
+        return simpsonStep(f, a, b, fa, fm, fb, (b - a) / 6 * (fa + 4 * fm + fb), eps, depth);
+    }
+}
+
+/**
+ * \brief Statistical test of the sampling routines of BSDFs
+ *
+ * For a few random incident directions, every child BSDF is sampled many
+ * times. The histogram of the outgoing directions is compared with the
+ * integral of \ref BSDF::pdf() over each bin using Pearson's chi-square
+ * test. Every sample's weight is also checked against
+ * <tt>eval() * cos(theta_o) / pdf()</tt>.
+ */
+class ChiSquareTest : public Test {
+public:
+    ChiSquareTest(const PropertyList& propsList) {
+        /* Probability of rejecting a correct implementation, over all tests of a BSDF */
+        m_significanceLevel = propsList.getFloat("significanceLevel", 0.01f);
+
+        /* Number of bins in cos(theta), twice as many are used in phi */
+        m_cosThetaResolution = propsList.getInteger("resolution", 10);
+        m_phiResolution = 2 * m_cosThetaResolution;
+
+        /* Bins expected to receive fewer samples are pooled together */
+        m_minExpFrequency = propsList.getInteger("minExpFrequency", 5);
+
+        m_sampleCount = propsList.getInteger("sampleCount", m_cosThetaResolution * m_phiResolution * 5000);
+        m_testCount = propsList.getInteger("testCount", 5);
+    }
+
+    virtual ~ChiSquareTest() {
+        for (BSDF* bsdf : m_bsdfs)
+            delete bsdf;
+    }
+
+    void addChild(LuminaObject* obj) {
+        if (obj->getClassType() != EBSDF)
+            throw LuminaException("ChiSquareTest::addChild(<%s>) is not supported!", classTypeName(obj->getClassType()));
+        m_bsdfs.push_back(static_cast<BSDF*>(obj));
+    }
+
+    std::string toString() const {
+        return tfm::format(
+            "ChiSquareTest[\n"
+            "  significanceLevel = %f,\n"
+            "  resolution = %i,\n"
+            "  minExpFrequency = %i,\n"
+            "  sampleCount = %i,\n"
+            "  testCount = %i\n"
+            "]",
+            m_significanceLevel,
+            m_cosThetaResolution,
+            m_minExpFrequency,
+            m_sampleCount,
+            m_testCount
+        );
+    }
+
+protected:
+    int run() {
+        int failures = 0;
+        pcg32 random;
+
+        for (BSDF* bsdf : m_bsdfs) {
+            for (int i = 0; i < m_testCount; i++) {
+                Vector3f wi = Warp::squareToCosineHemisphere(Point2f(random.nextFloat(), random.nextFloat()));
+
+                std::cout << "------------------------------------------------------" << std::endl;
+                std::cout << "Testing (" << i + 1 << "/" << m_testCount << "): " << bsdf->toString() << std::endl;
+                std::cout << "Incident direction: " << wi.toString() << std::endl;
+
+                if (!runTest(bsdf, wi, random))
+                    failures++;
+            }
+        }
+
+        return failures;
+    }
+
+    std::string getName() const { return "chi-square"; }
+
+private:
+    bool runTest(const BSDF* bsdf, const Vector3f& wi, pcg32& random) const {
+        int cellCount = m_cosThetaResolution * m_phiResolution;
+        std::vector<double> observed(cellCount, 0.0), expected(cellCount, 0.0);
+
+        /* Histogram of the sampled directions */
+        for (int i = 0; i < m_sampleCount; i++) {
+            BSDFQueryRecord bRec(wi);
+            Color3f result = bsdf->sample(bRec, Point2f(random.nextFloat(), random.nextFloat()));
+            if ((result == 0.0f).all())
+                continue;
+
+            if (bRec.measure == EDiscrete) {
+                std::cout << "The BSDF sampled a discrete direction, which this test does not support" << std::endl;
+                return false;
+            }
+
+            /* The sampling weight has to match the evaluated BSDF and density */
+            Color3f reference = bsdf->eval(bRec) * Frame::cosTheta(bRec.wo) / bsdf->pdf(bRec);
+            if (!reference.isValid() || ((reference - result).abs() > 1e-3f * reference.abs().max(1e-3f)).any()) {
+                std::cout << tfm::format("Inconsistency between sample() = %s and eval() * cos / pdf() = %s for wo = %s",
+                                         result.toString(), reference.toString(), bRec.wo.toString()) << std::endl;
+                return false;
+            }
+
+            float phi = std::atan2(bRec.wo.y(), bRec.wo.x());
+            if (phi < 0)
+                phi += 2 * M_PI;
+            int phiBin = std::min((int) (phi * INV_TWOPI * m_phiResolution), m_phiResolution - 1);
+            int cosThetaBin = std::min(std::max((int) ((bRec.wo.z() + 1) * 0.5f * m_cosThetaResolution), 0),
+                                       m_cosThetaResolution - 1);
+            observed[cosThetaBin * m_phiResolution + phiBin]++;
+        }
+
+        /* Integrate the density over every bin */
+        double phiStep = 2 * M_PI / m_phiResolution, cosThetaStep = 2.0 / m_cosThetaResolution;
+        for (int y = 0; y < m_cosThetaResolution; y++) {
+            /* Both bounds from the index, so that the bins meet exactly at the horizon */
+            double cosTheta0 = -1 + y * cosThetaStep, cosTheta1 = -1 + (y + 1) * cosThetaStep;
+            for (int x = 0; x < m_phiResolution; x++) {
+                double phi0 = x * phiStep, phi1 = (x + 1) * phiStep;
+                double integral = adaptiveSimpson([&](double cosTheta) {
+                    return adaptiveSimpson([&](double phi) {
+                        double sinTheta = std::sqrt(std::max(0.0, 1 - cosTheta * cosTheta));
+                        BSDFQueryRecord bRec(wi, Vector3f((float) (sinTheta * std::cos(phi)), (float) (sinTheta * std::sin(phi)),
+                                                          (float) cosTheta), ESolidAngle);
+                        return (double) bsdf->pdf(bRec);
+                    }, phi0, phi1);
+                }, cosTheta0, cosTheta1);
+                expected[y * m_phiResolution + x] = integral * m_sampleCount;
+            }
+        }
+
+        /* Visit the cells by increasing expected frequency, pooling those below the minimum */
+        std::vector<int> cells(cellCount);
+        for (int i = 0; i < cellCount; i++)
+            cells[i] = i;
+        std::sort(cells.begin(), cells.end(), [&](int a, int b) { return expected[a] < expected[b]; });
+
+        double pooledObserved = 0, pooledExpected = 0, chiSquare = 0;
+        int dof = 0;
+        for (int cell : cells) {
+            if (expected[cell] == 0) {
+                if (observed[cell] > m_sampleCount * 1e-5) {
+                    std::cout << tfm::format("Encountered %i samples in a cell with expected frequency 0", (int) observed[cell])
+                              << std::endl;
+                    return false;
+                }
+            } else if (expected[cell] < m_minExpFrequency || (pooledExpected > 0 && pooledExpected < m_minExpFrequency)) {
+                pooledObserved += observed[cell];
+                pooledExpected += expected[cell];
+            } else {
+                chiSquare += (observed[cell] - expected[cell]) * (observed[cell] - expected[cell]) / expected[cell];
+                dof++;
+            }
+        }
+        if (pooledExpected > 0) {
+            chiSquare += (pooledObserved - pooledExpected) * (pooledObserved - pooledExpected) / pooledExpected;
+            dof++;
+        }
+        dof--;
+
+        if (dof <= 0) {
+            std::cout << "The number of degrees of freedom is too low" << std::endl;
+            return false;
+        }
+
+        /* Šidák correction of the significance level for the number of tests */
+        double pValue = 1 - incompleteGamma(dof * 0.5, chiSquare * 0.5);
+        double alpha = 1 - std::pow(1 - m_significanceLevel, 1.0 / m_testCount);
+
+        std::cout << tfm::format("Chi-square statistic = %f (dof = %i), p-value = %f, significance level = %f",
+                                 chiSquare, dof, pValue, alpha) << std::endl;
+        if (!std::isfinite(pValue) || pValue < alpha) {
+            std::cout << "Rejected the null hypothesis" << std::endl;
+            return false;
+        }
+
+        std::cout << "Accepted the null hypothesis" << std::endl;
+        return true;
+    }
+
+    std::vector<BSDF*> m_bsdfs;
+    float m_significanceLevel;
+    int m_cosThetaResolution, m_phiResolution;
+    int m_minExpFrequency;
+    int m_sampleCount;
+    int m_testCount;
+};
+
+LUMINA_REGISTER_CLASS(ChiSquareTest, "chi2test")
+LUMINA_NAMESPACE_END
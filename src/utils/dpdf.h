@@ -26,6 +26,8 @@ public:
 
     /// Clear all entries
     void clear() {
+        m_view = nullptr;
+        m_viewSize = 0;
         m_cdf.clear();
         m_cdf.push_back(0.0f);
         m_normalized = false;
@@ -41,14 +43,40 @@ public:
         m_cdf.push_back(m_cdf[m_cdf.size()-1] + pdfValue);
     }
 
+    /**
+     * \brief Refer to an already normalized distribution stored elsewhere
+     *
+     * Nothing is copied: \c cdf has to outlive the distribution (or the
+     * next call to \ref clear()), and the distribution cannot be appended to.
+     *
+     * \param cdf
+     *     Cumulative distribution with <tt>nEntries + 1</tt> values, starting at 0 and ending at 1
+     * \param sum
+     *     Original (unnormalized) sum of all entries
+     */
+    void setNormalized(const float *cdf, size_t nEntries, float sum) {
+        m_cdf.clear();
+        m_view = cdf;
+        m_viewSize = nEntries + 1;
+        m_sum = sum;
+        m_normalization = sum > 0 ? 1.0f / sum : 0.0f;
+        m_normalized = sum > 0;
+    }
+
+    /// Return the cumulative distribution (<tt>size() + 1</tt> values)
+    const float *getCDF() const {
+        return m_view ? m_view : m_cdf.data();
+    }
+
     /// Return the number of entries so far
     size_t size() const {
-        return m_cdf.size()-1;
+        return (m_view ? m_viewSize : m_cdf.size())-1;
     }
 
     /// Access an entry by its index
     float operator[](size_t entry) const {
-        return m_cdf[entry+1] - m_cdf[entry];
+        const float *cdf = getCDF();
+        return cdf[entry+1] - cdf[entry];
     }
 
     /// Have the probability densities been normalized?
@@ -102,10 +130,10 @@ public:
      *     The discrete index associated with the sample
      */
     size_t sample(float sampleValue) const {
-        std::vector<float>::const_iterator entry =
-                std::lower_bound(m_cdf.begin(), m_cdf.end(), sampleValue);
-        size_t index = (size_t) std::max((ptrdiff_t) 0, entry - m_cdf.begin() - 1);
-        return std::min(index, m_cdf.size()-2);
+        const float *cdf = getCDF();
+        const float *entry = std::lower_bound(cdf, cdf + size() + 1, sampleValue);
+        size_t index = (size_t) std::max((ptrdiff_t) 0, entry - cdf - 1);
+        return std::min(index, size()-1);
     }
 
     /**
@@ -136,8 +164,9 @@ public:
      */
     size_t sampleReuse(float &sampleValue) const {
         size_t index = sample(sampleValue);
-        sampleValue = (sampleValue - m_cdf[index])
-                      / (m_cdf[index + 1] - m_cdf[index]);
+        const float *cdf = getCDF();
+        sampleValue = (sampleValue - cdf[index])
+                      / (cdf[index + 1] - cdf[index]);
         return index;
     }
 
@@ -155,8 +184,9 @@ public:
      */
     size_t sampleReuse(float &sampleValue, float &pdf) const {
         size_t index = sample(sampleValue, pdf);
-        sampleValue = (sampleValue - m_cdf[index])
-                      / (m_cdf[index + 1] - m_cdf[index]);
+        const float *cdf = getCDF();
+        sampleValue = (sampleValue - cdf[index])
+                      / (cdf[index + 1] - cdf[index]);
         return index;
     }
 
@@ -168,15 +198,18 @@ public:
         std::string result = tfm::format("DiscretePDF[sum=%f, "
                                          "normalized=%f, pdf = {", m_sum, m_normalized);
 
-        for (size_t i=0; i<m_cdf.size(); ++i) {
+        for (size_t i=0; i<size(); ++i) {
             result += std::to_string(operator[](i));
-            if (i != m_cdf.size()-1)
+            if (i != size()-1)
                 result += ", ";
         }
         return result + "}]";
     }
 private:
     std::vector<float> m_cdf;
+    /// Distribution that is not owned (see \ref setNormalized()), used instead of \c m_cdf when set
+    const float *m_view = nullptr;
+    size_t m_viewSize = 0;
     float m_sum, m_normalization;
     bool m_normalized;
 };
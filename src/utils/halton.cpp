@@ -0,0 +1,69 @@
+//
+// Created by agent on 10/18/26.
+//
+
+#include "sampler.h"
+#include "lowDiscrepancy.h"
+
+LUMINA_NAMESPACE_BEGIN
+
+const uint32_t Primes[LUMINA_PRIME_COUNT] = {
+    2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53,
+    59, 61, 67, 71, 73, 79, 83, 89, 97, 101, 103, 107, 109, 113, 127, 131,
+    137, 139, 149, 151, 157, 163, 167, 173, 179, 181, 191, 193, 197, 199, 211, 223,
+    227, 229, 233, 239, 241, 251, 257, 263, 269, 271, 277, 281, 283, 293, 307, 311,
+    313, 317, 331, 337, 347, 349, 353, 359, 367, 373, 379, 383, 389, 397, 401, 409,
+    419, 421, 431, 433, 439, 443, 449, 457, 461, 463, 467, 479, 487, 491, 499, 503,
+    509, 521, 523, 541, 547, 557, 563, 569, 571, 577, 587, 593, 599, 601, 607, 613,
+    617, 619, 631, 641, 643, 647, 653, 659, 661, 673, 677, 683, 691, 701, 709, 719
+};
+
+/**
+ * \brief Owen-scrambled Halton sampler
+ *
+ * Dimension \c d of sample \c i is the radical inverse of \c i in the
+ * base of the d-th prime. Every pixel scrambles the digits with its own
+ * random permutations, which decorrelates pixels and also breaks up the
+ * correlation between the higher dimensions of the plain sequence.
+ * Dimensions past the last prime are independent random values.
+ *
+ * Properties: \c sampleCount and \c seed.
+ */
+class Halton : public Sampler {
+public:
+    Halton(const PropertyList& propsList) {
+        m_sampleCount = (size_t) propsList.getInteger("sampleCount", 1);
+        m_seed = (uint32_t) propsList.getInteger("seed", 0);
+    }
+
+    std::unique_ptr<Sampler> clone() const {
+        return std::unique_ptr<Sampler>(new Halton(*this));
+    }
+
+    float next1D() {
+        return sample(m_dimension++);
+    }
+
+    Point2f next2D() {
+        float x = sample(m_dimension), y = sample(m_dimension + 1);
+        m_dimension += 2;
+        return Point2f(x, y);
+    }
+
+    std::string toString() const {
+        return tfm::format("Halton[sampleCount=%i, seed=%i]", m_sampleCount, m_seed);
+    }
+private:
+    float sample(uint32_t dimension) const {
+        uint64_t hash = hashSample(m_pixel, dimension, m_seed);
+        if (dimension >= LUMINA_PRIME_COUNT)
+            return toUnitFloat((uint32_t) mixBits(hash ^ m_sampleIndex));
+
+        return owenScrambledRadicalInverse((int) dimension, m_sampleIndex, hash);
+    }
+
+    uint32_t m_seed;
+};
+
+LUMINA_REGISTER_CLASS(Halton, "halton")
+LUMINA_NAMESPACE_END
@@ -0,0 +1,127 @@
+//
+// Created by agent on 10/18/26.
+//
+
+#include "utils/test.h"
+#include "scene/lightSampler.h"
+#include "pcg32/pcg32.h"
+
+LUMINA_NAMESPACE_BEGIN
+
+/**
+ * \brief Consistency check of \ref LightSampler::sample() and \ref LightSampler::pdf()
+ *
+ * Builds every type of light sampler over a chain of point lights at
+ * exponentially growing distances, which the SAH splits off a few at a time,
+ * and a large cluster of coincident lights, which can only be split by
+ * count and so makes the light BVH deep. At random shading points, the
+ * probabilities of all emitters have to sum to one, and every sampled
+ * emitter has to come with the probability \ref LightSampler::pdf()
+ * reports for it.
+ */
+class LightSamplerTest : public Test {
+public:
+    LightSamplerTest(const PropertyList& propsList) {
+        m_chainLength = propsList.getInteger("chainLength", 56);
+        m_clusterSize = propsList.getInteger("clusterSize", 1 << 16);
+        m_queryCount = propsList.getInteger("queryCount", 20);
+        m_sampleCount = propsList.getInteger("sampleCount", 10000);
+    }
+
+    virtual ~LightSamplerTest() {
+        for (Emitter* emitter : m_emitters)
+            delete emitter;
+    }
+
+    std::string toString() const {
+        return tfm::format(
+            "LightSamplerTest[\n"
+            "  chainLength = %i,\n"
+            "  clusterSize = %i,\n"
+            "  queryCount = %i,\n"
+            "  sampleCount = %i\n"
+            "]",
+            m_chainLength,
+            m_clusterSize,
+            m_queryCount,
+            m_sampleCount
+        );
+    }
+
+protected:
+    int run() {
+        for (int i = 0; i < m_chainLength + m_clusterSize; i++) {
+            PropertyList props;
+            float x = i < m_chainLength ? std::ldexp(1.0f, i) : 0.0f;
+            props.setPoint("position", Point3f(x, x, x));
+            m_emitters.push_back(static_cast<Emitter*>(LuminaObjectFactory::createInstance("pointLight", props)));
+        }
+
+        BoundingBox3f sceneBounds;
+        for (Emitter* emitter : m_emitters) {
+            LightBounds bounds;
+            emitter->getLightBounds(bounds);
+            sceneBounds.expandBy(bounds.bounds);
+        }
+
+        int failures = 0;
+        const LightSampler::EType types[] = { LightSampler::EUniform, LightSampler::EPower, LightSampler::EBVH };
+        for (LightSampler::EType type : types) {
+            LightSampler sampler(type);
+            sampler.build(m_emitters, sceneBounds);
+            failures += runTest(sampler);
+        }
+        return failures;
+    }
+
+    std::string getName() const { return "light sampler"; }
+
+private:
+    /// Returns the number of failed checks
+    int runTest(const LightSampler& sampler) const {
+        pcg32 random;
+        int failures = 0;
+
+        for (int query = 0; query < m_queryCount; query++) {
+            Point3f p(random.nextFloat() * 4 - 2, random.nextFloat() * 4 - 2, random.nextFloat() * 4 - 2);
+            Normal3f n = query % 2 == 0 ? Normal3f(0.0f)
+                                        : Normal3f(Vector3f(random.nextFloat() - 0.5f, random.nextFloat() - 0.5f, 1.0f).normalized());
+
+            double sum = 0.0;
+            for (const Emitter* emitter : m_emitters)
+                sum += sampler.pdf(p, n, emitter);
+            if (std::abs(sum - 1.0) > 1e-3) {
+                std::cout << tfm::format("%s: the probabilities at %s sum to %f", sampler.toString(), p.toString(), sum)
+                          << std::endl;
+                failures++;
+            }
+
+            for (int i = 0; i < m_sampleCount; i++) {
+                float pdf;
+                const Emitter* emitter = sampler.sample(p, n, random.nextFloat(), pdf);
+                if (!emitter)
+                    continue;
+
+                float reference = sampler.pdf(p, n, emitter);
+                if (!(std::abs(pdf - reference) <= 1e-4f * reference)) {
+                    std::cout << tfm::format("%s: sample() = %f but pdf() = %f at %s", sampler.toString(), pdf, reference,
+                                             p.toString()) << std::endl;
+                    failures++;
+                    break;
+                }
+            }
+        }
+
+        std::cout << sampler.toString() << ": " << failures << " failures" << std::endl;
+        return failures;
+    }
+
+    std::vector<Emitter*> m_emitters;
+    int m_chainLength;
+    int m_clusterSize;
+    int m_queryCount;
+    int m_sampleCount;
+};
+
+LUMINA_REGISTER_CLASS(LightSamplerTest, "lightsamplertest")
+LUMINA_NAMESPACE_END
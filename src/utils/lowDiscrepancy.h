@@ -0,0 +1,151 @@
+//
+// Created by agent on 10/18/26.
+//
+
+#pragma once
+
+#include "core/common.h"
+
+LUMINA_NAMESPACE_BEGIN
+
+/// Largest float below one, sample values are clamped to it
+#define LUMINA_ONE_MINUS_EPSILON 0x1.fffffep-1f
+
+/// Number of dimensions of the Halton sequence, one per prime
+#define LUMINA_PRIME_COUNT 128
+
+extern const uint32_t Primes[LUMINA_PRIME_COUNT];
+
+/// Scramble the bits of a 64-bit value (the finalizer of SplitMix64)
+inline uint64_t mixBits(uint64_t v) {
+    v ^= v >> 31;
+    v *= 0x7fb5d329728ea185ULL;
+    v ^= v >> 27;
+    v *= 0x81dadef4bc2dd44dULL;
+    v ^= v >> 33;
+    return v;
+}
+
+/// Hash a pixel, a dimension and a seed, used to decorrelate the samples of different pixels and dimensions
+inline uint64_t hashSample(const Point2i& pixel, uint32_t dimension, uint32_t seed) {
+    uint64_t key = ((uint64_t) (uint32_t) pixel.x() << 32) | (uint32_t) pixel.y();
+    return mixBits(mixBits(key) ^ (((uint64_t) seed << 32) | dimension));
+}
+
+/// Map the 32 bits of a value to [0, 1)
+inline float toUnitFloat(uint32_t v) {
+    return std::min(v * 0x1p-32f, LUMINA_ONE_MINUS_EPSILON);
+}
+
+inline uint32_t reverseBits(uint32_t v) {
+    v = (v << 16) | (v >> 16);
+    v = ((v & 0x00ff00ff) << 8) | ((v & 0xff00ff00) >> 8);
+    v = ((v & 0x0f0f0f0f) << 4) | ((v & 0xf0f0f0f0) >> 4);
+    v = ((v & 0x33333333) << 2) | ((v & 0xcccccccc) >> 2);
+    v = ((v & 0x55555555) << 1) | ((v & 0xaaaaaaaa) >> 1);
+    return v;
+}
+
+/**
+ * \brief Element \c i of a random permutation of [0, count) chosen by \c seed
+ *
+ * Evaluates the permutation without storing it (Kensler, "Correlated
+ * Multi-Jittered Sampling").
+ */
+inline uint32_t permutationElement(uint32_t i, uint32_t count, uint32_t seed) {
+    uint32_t w = count - 1;
+    w |= w >> 1;
+    w |= w >> 2;
+    w |= w >> 4;
+    w |= w >> 8;
+    w |= w >> 16;
+
+    /* Walk the cycle of a permutation of [0, w] until it lands in [0, count) */
+    do {
+        i ^= seed;
+        i *= 0xe170893d;
+        i ^= seed >> 16;
+        i ^= (i & w) >> 4;
+        i ^= seed >> 8;
+        i *= 0x0929eb3f;
+        i ^= seed >> 23;
+        i ^= (i & w) >> 1;
+        i *= 1 | seed >> 27;
+        i *= 0x6935fa69;
+        i ^= (i & w) >> 11;
+        i *= 0x74dcb303;
+        i ^= (i & w) >> 2;
+        i *= 0x9e501cc3;
+        i ^= (i & w) >> 2;
+        i *= 0xc860a3df;
+        i &= w;
+        i ^= i >> 5;
+    } while (i >= count);
+
+    return (i + seed) % count;
+}
+
+/**
+ * \brief Point \c index of one of the first two dimensions of the Sobol sequence, as a 32-bit fraction
+ *
+ * The first dimension is the van der Corput sequence, the generator
+ * matrix of the second one is Pascal's triangle modulo two.
+ */
+inline uint32_t sobolSample(uint32_t index, int dimension) {
+    if (dimension == 0)
+        return reverseBits(index);
+
+    uint32_t result = 0;
+    for (uint32_t v = 0x80000000u; index != 0; index >>= 1, v ^= v >> 1) {
+        if (index & 1)
+            result ^= v;
+    }
+    return result;
+}
+
+/**
+ * \brief Owen-scramble a 32-bit binary fraction
+ *
+ * Every bit is flipped depending on the bits above it and the seed, which
+ * randomizes a point set while keeping its stratification (hash-based
+ * scrambling by Laine and Karras, with the constants of Burley).
+ */
+inline uint32_t owenScramble(uint32_t v, uint32_t seed) {
+    v = reverseBits(v);
+    v ^= v * 0x3d20adea;
+    v += seed;
+    v *= (seed >> 16) | 1;
+    v ^= v * 0x05526c56;
+    v ^= v * 0x53a22864;
+    return reverseBits(v);
+}
+
+/**
+ * \brief Owen-scrambled radical inverse of \c index in the base <tt>Primes[baseIndex]</tt>
+ *
+ * Every digit is permuted depending on the digits before it, including
+ * the infinitely many zero digits past the last one of \c index.
+ */
+inline float owenScrambledRadicalInverse(int baseIndex, uint64_t index, uint64_t hash) {
+    const uint32_t base = Primes[baseIndex];
+    const float invBase = 1.0f / (float) base;
+    const uint64_t limit = ~0ULL / base - base;
+
+    uint64_t reversedDigits = 0;
+    float invBaseM = 1.0f;
+    while (1.0f - (float) (base - 1) * invBaseM < 1.0f && reversedDigits < limit) {
+        uint64_t next = index / base;
+        uint32_t digit = (uint32_t) (index - next * base);
+
+        uint32_t digitHash = (uint32_t) mixBits(hash ^ reversedDigits);
+        digit = permutationElement(digit, base, digitHash);
+
+        reversedDigits = reversedDigits * base + digit;
+        invBaseM *= invBase;
+        index = next;
+    }
+
+    return std::min(invBaseM * (float) reversedDigits, LUMINA_ONE_MINUS_EPSILON);
+}
+
+LUMINA_NAMESPACE_END
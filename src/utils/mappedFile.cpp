@@ -0,0 +1,86 @@
+//
+// Created by agent on 10/17/26.
+//
+
+#include "mappedFile.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+LUMINA_NAMESPACE_BEGIN
+
+#if defined(_WIN32)
+MappedFile::MappedFile(const std::string &filename) {
+    m_file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                         OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (m_file == INVALID_HANDLE_VALUE) {
+        m_file = nullptr;
+        throw LuminaException("Unable to open \"%s\"", filename);
+    }
+
+    LARGE_INTEGER size;
+    GetFileSizeEx(m_file, &size);
+    m_size = (size_t) size.QuadPart;
+    if (m_size == 0)
+        return;
+
+    m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (m_mapping)
+        m_data = (const uint8_t *) MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!m_data) {
+        if (m_mapping)
+            CloseHandle(m_mapping);
+        CloseHandle(m_file);
+        throw LuminaException("Unable to map \"%s\"", filename);
+    }
+}
+
+MappedFile::~MappedFile() {
+    if (m_data)
+        UnmapViewOfFile(m_data);
+    if (m_mapping)
+        CloseHandle(m_mapping);
+    if (m_file)
+        CloseHandle(m_file);
+}
+#else
+MappedFile::MappedFile(const std::string &filename) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw LuminaException("Unable to open \"%s\"", filename);
+
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        throw LuminaException("Unable to query the size of \"%s\"", filename);
+    }
+
+    m_size = (size_t) info.st_size;
+    if (m_size > 0) {
+        void *data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            close(fd);
+            throw LuminaException("Unable to map \"%s\"", filename);
+        }
+        m_data = (const uint8_t *) data;
+    }
+
+    /* The mapping stays valid after the descriptor is closed */
+    close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (m_data)
+        munmap((void *) m_data, m_size);
+}
+#endif
+
+LUMINA_NAMESPACE_END
@@ -0,0 +1,42 @@
+//
+// Created by agent on 10/17/26.
+//
+
+#pragma once
+
+#include "core/common.h"
+
+LUMINA_NAMESPACE_BEGIN
+
+/**
+ * \brief Read-only memory mapping of a whole file
+ *
+ * The contents stay mapped (and are paged in on demand) until the
+ * object is destroyed.
+ */
+class MappedFile {
+public:
+    /// Map the given file, throws a \ref LuminaException on failure
+    explicit MappedFile(const std::string& filename);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const uint8_t* data() const { return m_data; }
+    size_t size() const { return m_size; }
+
+    /// Return a typed pointer to the element at the given byte offset
+    template <typename T> const T* at(size_t offset) const {
+        return reinterpret_cast<const T*>(m_data + offset);
+    }
+private:
+    const uint8_t* m_data = nullptr;
+    size_t m_size = 0;
+#if defined(_WIN32)
+    void* m_file = nullptr;
+    void* m_mapping = nullptr;
+#endif
+};
+
+LUMINA_NAMESPACE_END
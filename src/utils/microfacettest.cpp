@@ -0,0 +1,145 @@
+//
+// Created by agent on 10/18/26.
+//
+
+#include "utils/test.h"
+#include "bsdfs/bsdf.h"
+#include "primitives/frame.h"
+#include "utils/warp.h"
+#include "pcg32/pcg32.h"
+
+LUMINA_NAMESPACE_BEGIN
+
+namespace {
+    /// Uniformly distributed direction on the unit sphere
+    Vector3f uniformSphere(pcg32& random) {
+        float z = 2.0f * random.nextFloat() - 1.0f, phi = 2.0f * M_PI * random.nextFloat();
+        float r = std::sqrt(std::max(0.0f, 1.0f - z * z));
+        return Vector3f(r * std::cos(phi), r * std::sin(phi), z);
+    }
+
+    /// Smith shadowing term as the microfacet BRDF originally evaluated it
+    float referenceShadowing(const Vector3f& wv, const Vector3f& wh, float alpha) {
+        if (wv.dot(wh) / Frame::cosTheta(wv) <= 0.0f)
+            return 0.0f;
+
+        float b = 1.0f / (alpha * std::tan(std::acos(Frame::cosTheta(wv))));
+        if (b >= 1.6f)
+            return 1.0f;
+
+        float b2 = b * b;
+        return (3.535f * b + 2.181f * b2) / (1 + 2.276f * b + 2.577f * b2);
+    }
+}
+
+/**
+ * \brief Comparison of the microfacet BRDF against its original closed form
+ *
+ * Evaluates \ref BSDF::eval() and \ref BSDF::pdf() of microfacet materials
+ * with and without lookup tables next to a direct implementation of the
+ * Beckmann, Fresnel and Smith terms, over random pairs of directions. The
+ * exact path has to match to within float rounding, the tabulated one to
+ * within the interpolation error of the tables.
+ */
+class MicrofacetTest : public Test {
+public:
+    MicrofacetTest(const PropertyList& propsList) {
+        /* Number of random direction pairs per material */
+        m_sampleCount = propsList.getInteger("sampleCount", 100000);
+
+        /* Relative tolerances of the exact and the tabulated evaluation */
+        m_tolerance = propsList.getFloat("tolerance", 1e-3f);
+        m_tableTolerance = propsList.getFloat("tableTolerance", 2e-2f);
+    }
+
+    std::string toString() const {
+        return tfm::format(
+            "MicrofacetTest[\n"
+            "  sampleCount = %i,\n"
+            "  tolerance = %f,\n"
+            "  tableTolerance = %f\n"
+            "]",
+            m_sampleCount,
+            m_tolerance,
+            m_tableTolerance
+        );
+    }
+
+protected:
+    int run() {
+        int failures = 0;
+        const float alphas[] = { 0.05f, 0.1f, 0.3f, 0.7f };
+        const float kds[] = { 0.0f, 0.5f };
+
+        for (float alpha : alphas) {
+            for (float kd : kds) {
+                for (bool lookupTables : { false, true })
+                    failures += runTest(alpha, kd, lookupTables);
+            }
+        }
+        return failures;
+    }
+
+    std::string getName() const { return "microfacet"; }
+
+private:
+    /// Returns the number of mismatches for one material
+    int runTest(float alpha, float kd, bool lookupTables) const {
+        const float extIOR = 1.000277f, intIOR = 1.5046f;
+
+        PropertyList props;
+        props.setFloat("alpha", alpha);
+        props.setFloat("extIOR", extIOR);
+        props.setFloat("intIOR", intIOR);
+        props.setColor("kd", Color3f(kd));
+        props.setBoolean("lookupTables", lookupTables);
+        std::unique_ptr<BSDF> bsdf(static_cast<BSDF*>(LuminaObjectFactory::createInstance("microfacet", props)));
+
+        float ks = 1 - kd, tolerance = lookupTables ? m_tableTolerance : m_tolerance;
+        pcg32 random;
+        int failures = 0;
+        float maxError = 0.0f;
+
+        for (int i = 0; i < m_sampleCount; i++) {
+            BSDFQueryRecord bRec(uniformSphere(random), uniformSphere(random), ESolidAngle);
+            float cosThetai = Frame::cosTheta(bRec.wi), cosThetao = Frame::cosTheta(bRec.wo);
+
+            float value = 0.0f, pdf = 0.0f;
+            if (cosThetai > 0.0f && cosThetao > 0.0f) {
+                Vector3f wh = (bRec.wi + bRec.wo).normalized();
+                float D = Warp::squareToBeckmannPdf(wh, alpha);
+                float F = fresnel(wh.dot(bRec.wi), extIOR, intIOR);
+                float G = referenceShadowing(bRec.wi, wh, alpha) * referenceShadowing(bRec.wo, wh, alpha);
+
+                value = kd * INV_PI + ks * D * F * G / (4.0f * Frame::cosTheta(wh) * cosThetai * cosThetao);
+                pdf = ks * D / (4.0f * wh.dot(bRec.wo)) + (1 - ks) * cosThetao * INV_PI;
+            }
+
+            /* The terms grow without bound at grazing angles, so compare relative to at least one */
+            float valueError = std::abs(bsdf->eval(bRec).r() - value) / std::max(value, 1.0f);
+            float pdfError = std::abs(bsdf->pdf(bRec) - pdf) / std::max(pdf, 1.0f);
+            float error = std::max(valueError, pdfError);
+            maxError = std::max(maxError, error);
+
+            if (!(error <= tolerance)) {
+                if (failures < 10) {
+                    std::cout << tfm::format("alpha = %f, kd = %f, lookupTables = %i: eval() = %f, pdf() = %f but "
+                                             "expected %f, %f for wi = %s, wo = %s", alpha, kd, (int) lookupTables,
+                                             bsdf->eval(bRec).r(), bsdf->pdf(bRec), value, pdf,
+                                             bRec.wi.toString(), bRec.wo.toString()) << std::endl;
+                }
+                failures++;
+            }
+        }
+
+        std::cout << tfm::format("alpha = %f, kd = %f, lookupTables = %i: maximum relative error %e, %i failures",
+                                 alpha, kd, (int) lookupTables, maxError, failures) << std::endl;
+        return failures;
+    }
+
+    int m_sampleCount;
+    float m_tolerance, m_tableTolerance;
+};
+
+LUMINA_REGISTER_CLASS(MicrofacetTest, "microfacettest")
+LUMINA_NAMESPACE_END
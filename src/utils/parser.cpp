@@ -3,6 +3,7 @@
 //
 
 #include "parser.h"
+#include "stats.h"
 #include "Eigen/Geometry"
 
 #include <fstream>
@@ -46,13 +47,45 @@ void check_attributes(std::string& filename, const pugi::xml_node& node, std::se
               filename, *attrs.begin(), node.name(), offset(filename, node.offset_debug()));
 }
 
-LuminaObject* loadXMLFile(std::string &filename) {
+LuminaObject* loadXMLFile(std::string &filename, const std::map<std::string, std::string>& overrides) {
+    StatPhase phase(EPhaseParse);
     pugi::xml_document doc;
     pugi::xml_parse_result result = doc.load_file(filename.c_str());
     if (!result)
         throw LuminaException("Error while parsing %s: %s (at %s)",
               filename, result.description(), offset(filename, result.offset));
 
+    if (!overrides.empty()) {
+        std::set<std::string> matched;
+
+        std::function<void(pugi::xml_node)> applyOverrides = [&](pugi::xml_node node) {
+            for (pugi::xml_node child : node.children()) {
+                pugi::xml_attribute name = child.attribute("name"), value = child.attribute("value");
+
+                /* The qualified key comes second so that it wins */
+                if (name && value) {
+                    for (const std::string& key : { std::string(name.value()),
+                                                    std::string(node.name()) + "." + name.value() }) {
+                        auto it = overrides.find(key);
+                        if (it != overrides.end()) {
+                            value.set_value(it->second.c_str());
+                            matched.insert(key);
+                        }
+                    }
+                }
+
+                applyOverrides(child);
+            }
+        };
+        applyOverrides(doc);
+
+        for (const auto& entry : overrides) {
+            if (matched.find(entry.first) == matched.end())
+                throw LuminaException("Error while parsing \"%s\": no property matches the override \"%s\"",
+                                      filename, entry.first);
+        }
+    }
+
     enum ETag {
         EScene = LuminaObject::EScene,
         EMesh = LuminaObject::EMesh,
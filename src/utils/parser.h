@@ -9,11 +9,22 @@
 
 #include <pugixml.hpp>
 #include <set>
+#include <map>
 
 LUMINA_NAMESPACE_BEGIN
 
 std::string offset(std::string& filename, ptrdiff_t pos);
 void check_attributes(std::string& filename, const pugi::xml_node& node, std::set<std::string> attrs);
-LuminaObject* loadXMLFile(std::string& filename);
+
+/**
+ * \brief Load a scene (or other object) description
+ *
+ * \param overrides
+ *     Replacement values of properties in the file. A key \c name applies
+ *     to every property with that name, a key \c tag.name (e.g.
+ *     \c sampler.sampleCount) only to those directly inside a \c tag
+ *     element and takes precedence. Every key has to match a property.
+ */
+LuminaObject* loadXMLFile(std::string& filename, const std::map<std::string, std::string>& overrides = {});
 
 LUMINA_NAMESPACE_END
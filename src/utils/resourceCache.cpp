@@ -0,0 +1,47 @@
+//
+// Created by agent on 10/17/26.
+//
+
+#include "resourceCache.h"
+
+LUMINA_NAMESPACE_BEGIN
+
+void ResourceCache::setEnabled(bool enabled) {
+    m_enabled = enabled;
+    if (!enabled)
+        clear();
+}
+
+size_t ResourceCache::trim() {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    size_t count = 0;
+
+    for (auto it = m_entries.begin(); it != m_entries.end(); ) {
+        if (it->second.use_count() == 1) {
+            it = m_entries.erase(it);
+            count++;
+        } else {
+            ++it;
+        }
+    }
+
+    return count;
+}
+
+void ResourceCache::clear() {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    m_entries.clear();
+}
+
+size_t ResourceCache::size() const {
+    std::lock_guard<std::mutex> guard(m_mutex);
+    return m_entries.size();
+}
+
+ResourceCache* getResourceCache() {
+    static ResourceCache* cache = new ResourceCache();
+
+    return cache;
+}
+
+LUMINA_NAMESPACE_END
@@ -0,0 +1,66 @@
+//
+// Created by agent on 10/17/26.
+//
+
+#pragma once
+
+#include "core/common.h"
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+LUMINA_NAMESPACE_BEGIN
+
+/**
+ * \brief Process-wide cache of loaded data that consecutive scenes can share
+ *
+ * Batch rendering enables it so that jobs referencing the same mesh files
+ * (or the same geometry, for acceleration structures) don't parse or build
+ * them again. Keys start with a prefix naming the type of the value, e.g.
+ * "obj:". While disabled (the default), nothing is stored and \ref find()
+ * never returns anything.
+ */
+class ResourceCache {
+public:
+    void setEnabled(bool enabled);
+    bool isEnabled() const { return m_enabled; }
+
+    /// Return the value stored under \c key, or \c nullptr
+    template <typename T> std::shared_ptr<const T> find(const std::string& key) {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        auto it = m_entries.find(key);
+        if (it == m_entries.end())
+            return nullptr;
+        return std::static_pointer_cast<const T>(it->second);
+    }
+
+    /// Store a value (if enabled), replacing any previous value of \c key
+    template <typename T> void insert(const std::string& key, const std::shared_ptr<const T>& value) {
+        if (!m_enabled)
+            return;
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_entries[key] = std::static_pointer_cast<const void>(value);
+    }
+
+    /**
+     * \brief Drop the entries that are not referenced outside the cache
+     *
+     * Called after loading a scene, this keeps exactly what that scene uses.
+     * \return The number of entries that were dropped
+     */
+    size_t trim();
+
+    /// Drop all entries
+    void clear();
+
+    size_t size() const;
+private:
+    bool m_enabled = false;
+    mutable std::mutex m_mutex;
+    std::unordered_map<std::string, std::shared_ptr<const void>> m_entries;
+};
+
+/// Return the global resource cache
+ResourceCache* getResourceCache();
+
+LUMINA_NAMESPACE_END
@@ -3,6 +3,7 @@
 //
 
 #include "sampler.h"
+#include "lowDiscrepancy.h"
 
 LUMINA_NAMESPACE_BEGIN
 
@@ -15,26 +16,28 @@ std::unique_ptr<Sampler> Independent::clone() const {
     cloned->m_sampleCount = m_sampleCount;
     cloned->m_random = m_random;
 
-    return std::move(cloned);
+    return cloned;
 }
 
-void Independent::prepare(const ImageBlock &block) {
-    m_random.seed(
-            block.getOffset().x(),
-            block.getOffset().y()
-            );
-}
-
-void Independent::generate() { }
+void Independent::setSample(const Point2i &pixel, size_t sampleIndex, uint32_t dimension) {
+    Sampler::setSample(pixel, sampleIndex, dimension);
 
-void Independent::advance() { }
+    /* Every sample of every pixel gets its own stream */
+    m_random.seed(hashSample(pixel, 0, 0), m_sampleIndex);
+    if (dimension > 0)
+        m_random.advance(dimension);
+}
 
 float Independent::next1D() {
+    m_dimension++;
     return m_random.nextFloat();
 }
 
 Point2f Independent::next2D() {
-    return Point2f(m_random.nextFloat(), m_random.nextFloat());
+    m_dimension += 2;
+    /* Draw in sequence, the order in which arguments are evaluated is unspecified */
+    float x = m_random.nextFloat();
+    return Point2f(x, m_random.nextFloat());
 }
 std::string Independent::toString() const {
     return tfm::format("Independent[sampleCount=%i]", m_sampleCount);
@@ -10,31 +10,100 @@
 
 LUMINA_NAMESPACE_BEGIN
 
+/**
+ * \brief Source of the sample values of an integrator
+ *
+ * Values are organised by pixel, sample index within the pixel and
+ * dimension: \ref generate() starts the first sample of a pixel,
+ * \ref advance() moves on to the next one, and every call to
+ * \ref next1D() or \ref next2D() consumes one or two dimensions of the
+ * current sample. Samplers that stratify or use low-discrepancy sequences
+ * rely on the integrator drawing the same kind of value in the same
+ * dimension of every sample.
+ */
 class Sampler : public LuminaObject {
 public:
     virtual ~Sampler() {}
 
     virtual std::unique_ptr<Sampler> clone() const = 0;
 
-    virtual void prepare(const ImageBlock& block) = 0;
+    /**
+     * \brief Prepare to render the given block
+     *
+     * \param firstSample
+     *     Index of the first sample per pixel that will be taken, so that
+     *     a block rendered over several passes receives a different but
+     *     deterministic sequence in each of them
+     */
+    virtual void prepare(const ImageBlock& block, size_t firstSample = 0) {
+        m_firstSample = firstSample;
+        setSample(block.getOffset(), 0, 0);
+    }
 
-    virtual void generate() = 0;
-    virtual void advance() = 0;
+    /// Start the first sample of a pixel
+    void generate(const Point2i& pixel) { setSample(pixel, 0, 0); }
+
+    /// Move on to the next sample of the current pixel
+    void advance() { setSample(m_pixel, m_sampleIndex - m_firstSample + 1, 0); }
+
+    /**
+     * \brief Continue a given sample of a pixel from a given dimension
+     *
+     * Lets integrators that interleave many paths (such as \c path_wavefront)
+     * give each of them the values it would receive if it was traced alone.
+     *
+     * \param sampleIndex
+     *     Index of the sample, counted from the \c firstSample passed to \ref prepare()
+     */
+    virtual void setSample(const Point2i& pixel, size_t sampleIndex, uint32_t dimension) {
+        m_pixel = pixel;
+        m_sampleIndex = m_firstSample + sampleIndex;
+        m_dimension = dimension;
+    }
 
     virtual float next1D() = 0;
     virtual Point2f next2D() = 0;
 
+    /// Draw \c count 1D values in a row, the same as calling \ref next1D() \c count times
+    virtual void fill1D(float* values, size_t count) {
+        for (size_t i = 0; i < count; i++)
+            values[i] = next1D();
+    }
+
+    /// Draw \c count 2D values in a row, the same as calling \ref next2D() \c count times
+    virtual void fill2D(Point2f* values, size_t count) {
+        for (size_t i = 0; i < count; i++)
+            values[i] = next2D();
+    }
+
     void addChild(lumina::LuminaObject *child) override {
 
     }
 
+    const Point2i& getPixel() const { return m_pixel; }
+    /// Index of the current sample, counted from the \c firstSample passed to \ref prepare()
+    size_t getSampleIndex() const { return m_sampleIndex - m_firstSample; }
+    /// Number of dimensions of the current sample consumed so far
+    uint32_t getDimension() const { return m_dimension; }
+
     virtual size_t getSampleCount() const { return m_sampleCount; }
     EClassType getClassType() const { return ESampler; }
 
 protected:
     size_t m_sampleCount;
+
+    size_t m_firstSample = 0;
+    Point2i m_pixel = Point2i(0, 0);
+    /// Index of the current sample including \c m_firstSample
+    size_t m_sampleIndex = 0;
+    uint32_t m_dimension = 0;
 };
 
+/**
+ * \brief Independent uniform random values
+ *
+ * Every sample of every pixel draws from its own PCG32 stream.
+ */
 class Independent : public Sampler {
 public:
     Independent(const PropertyList& propsList);
@@ -43,9 +112,7 @@ public:
 
     std::unique_ptr<Sampler> clone() const;
 
-    void prepare(const ImageBlock& block);
-    void generate();
-    void advance();
+    void setSample(const Point2i& pixel, size_t sampleIndex, uint32_t dimension);
 
     float next1D();
     Point2f next2D();
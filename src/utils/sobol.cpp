@@ -0,0 +1,72 @@
+//
+// Created by agent on 10/18/26.
+//
+
+#include "sampler.h"
+#include "lowDiscrepancy.h"
+
+LUMINA_NAMESPACE_BEGIN
+
+/**
+ * \brief Owen-scrambled Sobol sampler
+ *
+ * Every 1D or 2D request takes a point of the first one or two
+ * dimensions of the Sobol sequence, where any power-of-two number of
+ * consecutive points is perfectly stratified. The samples of a pixel are
+ * shuffled by a random permutation that differs between dimensions, and
+ * the points are Owen-scrambled per pixel and dimension, so that
+ * dimensions and pixels are uncorrelated (this "padding" avoids the poor
+ * 2D projections of the higher dimensions of the sequence).
+ *
+ * Sample counts that are powers of two work best.
+ *
+ * Properties: \c sampleCount and \c seed.
+ */
+class Sobol : public Sampler {
+public:
+    Sobol(const PropertyList& propsList) {
+        m_sampleCount = (size_t) propsList.getInteger("sampleCount", 1);
+        m_seed = (uint32_t) propsList.getInteger("seed", 0);
+    }
+
+    std::unique_ptr<Sampler> clone() const {
+        return std::unique_ptr<Sampler>(new Sobol(*this));
+    }
+
+    float next1D() {
+        uint64_t hash = hashSample(m_pixel, m_dimension++, m_seed);
+        uint32_t index = getIndex((uint32_t) hash);
+
+        return toUnitFloat(owenScramble(sobolSample(index, 0), (uint32_t) (hash >> 32)));
+    }
+
+    Point2f next2D() {
+        uint64_t hash = hashSample(m_pixel, m_dimension, m_seed);
+        uint64_t scrambleHash = mixBits(hash);
+        uint32_t index = getIndex((uint32_t) hash);
+        m_dimension += 2;
+
+        return Point2f(
+                toUnitFloat(owenScramble(sobolSample(index, 0), (uint32_t) scrambleHash)),
+                toUnitFloat(owenScramble(sobolSample(index, 1), (uint32_t) (scrambleHash >> 32)))
+        );
+    }
+
+    std::string toString() const {
+        return tfm::format("Sobol[sampleCount=%i, seed=%i]", m_sampleCount, m_seed);
+    }
+private:
+    /// Index of the current sample in the sequence of the dimension, within the pixel's sample count
+    uint32_t getIndex(uint32_t permutationSeed) const {
+        uint32_t count = (uint32_t) m_sampleCount;
+        uint32_t round = (uint32_t) (m_sampleIndex / count);
+
+        /* Samples past the sample count continue with the next points of the sequence */
+        return round * count + permutationElement((uint32_t) (m_sampleIndex % count), count, permutationSeed);
+    }
+
+    uint32_t m_seed;
+};
+
+LUMINA_REGISTER_CLASS(Sobol, "sobol")
+LUMINA_NAMESPACE_END
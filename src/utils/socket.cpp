@@ -0,0 +1,207 @@
+//
+// Created by agent on 10/17/26.
+//
+
+#include "socket.h"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+LUMINA_NAMESPACE_BEGIN
+
+namespace {
+#if defined(_WIN32)
+    typedef SOCKET Handle;
+    const Handle InvalidHandle = INVALID_SOCKET;
+
+    inline void closeHandle(Handle handle) { closesocket(handle); }
+    inline std::string lastError() { return tfm::format("error %i", WSAGetLastError()); }
+
+    /// Winsock needs to be initialized once per process
+    void initialize() {
+        static bool initialized = [] {
+            WSADATA data;
+            if (WSAStartup(MAKEWORD(2, 2), &data) != 0)
+                throw LuminaException("Unable to initialize Winsock");
+            return true;
+        }();
+        (void) initialized;
+    }
+#else
+    typedef int Handle;
+    const Handle InvalidHandle = -1;
+
+    inline void closeHandle(Handle handle) { ::close(handle); }
+    inline std::string lastError() { return strerror(errno); }
+    inline void initialize() { }
+#endif
+
+#if defined(MSG_NOSIGNAL)
+    /* Report a closed connection as an error instead of raising SIGPIPE */
+    const int SendFlags = MSG_NOSIGNAL;
+#else
+    const int SendFlags = 0;
+#endif
+
+    /// Return a readable "host:port" string of a socket address
+    std::string addressString(const sockaddr* address, socklen_t length) {
+        char host[NI_MAXHOST], port[NI_MAXSERV];
+        if (getnameinfo(address, length, host, sizeof(host), port, sizeof(port), NI_NUMERICHOST | NI_NUMERICSERV) != 0)
+            return "unknown";
+        return tfm::format("%s:%s", host, port);
+    }
+
+    struct MessageHeader {
+        uint32_t type;
+        uint32_t reserved;
+        uint64_t size;
+    };
+}
+
+Socket::~Socket() {
+    closeHandle((Handle) m_handle);
+}
+
+std::unique_ptr<Socket> Socket::listen(int port) {
+    initialize();
+
+    Handle handle = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (handle == InvalidHandle)
+        throw LuminaException("Unable to create a socket: %s", lastError());
+
+    int enable = 1;
+    setsockopt(handle, SOL_SOCKET, SO_REUSEADDR, (const char *) &enable, sizeof(enable));
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons((uint16_t) port);
+
+    if (bind(handle, (const sockaddr *) &address, sizeof(address)) != 0 || ::listen(handle, SOMAXCONN) != 0) {
+        std::string error = lastError();
+        closeHandle(handle);
+        throw LuminaException("Unable to listen on port %i: %s", port, error);
+    }
+
+    return std::unique_ptr<Socket>(new Socket((intptr_t) handle, tfm::format("*:%i", port)));
+}
+
+std::unique_ptr<Socket> Socket::connect(const std::string &host, int port) {
+    initialize();
+
+    addrinfo hints = {}, *addresses = nullptr;
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_protocol = IPPROTO_TCP;
+
+    std::string service = std::to_string(port);
+    if (getaddrinfo(host.c_str(), service.c_str(), &hints, &addresses) != 0 || !addresses)
+        throw LuminaException("Unable to resolve \"%s\"", host);
+
+    /* Try all addresses the name resolves to */
+    Handle handle = InvalidHandle;
+    std::string address;
+    for (addrinfo *it = addresses; it; it = it->ai_next) {
+        handle = socket(it->ai_family, it->ai_socktype, it->ai_protocol);
+        if (handle == InvalidHandle)
+            continue;
+        if (::connect(handle, it->ai_addr, (socklen_t) it->ai_addrlen) == 0) {
+            address = addressString(it->ai_addr, (socklen_t) it->ai_addrlen);
+            break;
+        }
+        closeHandle(handle);
+        handle = InvalidHandle;
+    }
+    freeaddrinfo(addresses);
+
+    if (handle == InvalidHandle)
+        throw LuminaException("Unable to connect to %s:%i: %s", host, port, lastError());
+
+    /* Messages are sent as soon as they are complete */
+    int enable = 1;
+    setsockopt(handle, IPPROTO_TCP, TCP_NODELAY, (const char *) &enable, sizeof(enable));
+
+    return std::unique_ptr<Socket>(new Socket((intptr_t) handle, address));
+}
+
+std::unique_ptr<Socket> Socket::accept() {
+    sockaddr_storage address = {};
+    socklen_t length = sizeof(address);
+
+    Handle handle = ::accept((Handle) m_handle, (sockaddr *) &address, &length);
+    if (handle == InvalidHandle)
+        throw LuminaException("Unable to accept a connection: %s", lastError());
+
+    int enable = 1;
+    setsockopt(handle, IPPROTO_TCP, TCP_NODELAY, (const char *) &enable, sizeof(enable));
+
+    return std::unique_ptr<Socket>(new Socket((intptr_t) handle, addressString((const sockaddr *) &address, length)));
+}
+
+void Socket::send(uint32_t type, const void *data, size_t size) {
+    MessageHeader header = { type, 0, (uint64_t) size };
+    if (!transfer(&header, sizeof(header), true) || (size > 0 && !transfer(const_cast<void *>(data), size, true)))
+        throw LuminaException("Connection to %s was closed", m_address);
+}
+
+bool Socket::receive(uint32_t &type, std::vector<uint8_t> &payload) {
+    MessageHeader header;
+    if (!transfer(&header, sizeof(header), false))
+        return false;
+
+    type = header.type;
+    payload.resize((size_t) header.size);
+    if (header.size > 0 && !transfer(payload.data(), payload.size(), false))
+        throw LuminaException("Connection to %s was closed in the middle of a message", m_address);
+    return true;
+}
+
+void Socket::shutdown() {
+#if defined(_WIN32)
+    ::shutdown((Handle) m_handle, SD_BOTH);
+#else
+    ::shutdown((Handle) m_handle, SHUT_RDWR);
+#endif
+}
+
+bool Socket::transfer(void *data, size_t size, bool sending) {
+    char *it = (char *) data;
+
+    while (size > 0) {
+        /* Transfer at most 1 GiB at once, as the size is an int on Windows */
+        int chunk = (int) std::min(size, (size_t) 1 << 30);
+        auto result = sending ? ::send((Handle) m_handle, it, chunk, SendFlags)
+                              : ::recv((Handle) m_handle, it, chunk, 0);
+
+        if (result == 0)
+            return false;
+        if (result < 0) {
+#if !defined(_WIN32)
+            if (errno == EINTR)
+                continue;
+#endif
+            /* A reset connection is reported like an orderly close */
+            if (!sending)
+                return false;
+            throw LuminaException("Unable to send to %s: %s", m_address, lastError());
+        }
+
+        it += result;
+        size -= (size_t) result;
+    }
+
+    return true;
+}
+
+LUMINA_NAMESPACE_END
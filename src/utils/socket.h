@@ -0,0 +1,66 @@
+//
+// Created by agent on 10/17/26.
+//
+
+#pragma once
+
+#include "core/common.h"
+#include <memory>
+
+LUMINA_NAMESPACE_BEGIN
+
+/**
+ * \brief Blocking TCP connection that exchanges typed, length-prefixed messages
+ *
+ * Every message consists of a 32-bit type, a 64-bit payload size and the
+ * payload itself. Both ends are expected to share the same byte order.
+ * All functions throw a \ref LuminaException on failure.
+ */
+class Socket {
+public:
+    ~Socket();
+
+    Socket(const Socket&) = delete;
+    Socket& operator=(const Socket&) = delete;
+
+    /// Create a socket that accepts connections on the given port (on all interfaces)
+    static std::unique_ptr<Socket> listen(int port);
+
+    /// Connect to a listening socket
+    static std::unique_ptr<Socket> connect(const std::string& host, int port);
+
+    /// Wait for the next incoming connection of a listening socket
+    std::unique_ptr<Socket> accept();
+
+    /// Send a message
+    void send(uint32_t type, const void* data, size_t size);
+
+    /// Send a message whose payload is a vector of trivially copyable values
+    template <typename T> void send(uint32_t type, const std::vector<T>& payload) {
+        send(type, payload.data(), payload.size() * sizeof(T));
+    }
+
+    /**
+     * \brief Receive the next message
+     *
+     * \return \c false if the other end closed the connection
+     *         instead of sending another message
+     */
+    bool receive(uint32_t& type, std::vector<uint8_t>& payload);
+
+    /// Stop all communication, which also makes a blocked \ref accept() fail
+    void shutdown();
+
+    /// Return the address of the other end (or of the listening port)
+    const std::string& getAddress() const { return m_address; }
+private:
+    Socket(intptr_t handle, const std::string& address) : m_handle(handle), m_address(address) { }
+
+    /// Send or receive exactly \c size bytes, returns \c false if the connection was closed
+    bool transfer(void* data, size_t size, bool sending);
+
+    intptr_t m_handle;
+    std::string m_address;
+};
+
+LUMINA_NAMESPACE_END
@@ -0,0 +1,102 @@
+//
+// Created by agent on 10/18/26.
+//
+
+#include "stats.h"
+
+#include <fstream>
+#include <sstream>
+
+LUMINA_NAMESPACE_BEGIN
+
+#if defined(LUMINA_HAS_STATS)
+namespace {
+    const char* counterNames[EStatCounterCount] = {
+        "cameraRays", "intersectionRays", "shadowRays", "russianRouletteTerminations", "invalidSamples"
+    };
+    const char* histogramNames[EStatHistogramCount] = { "nodesPerRay", "trianglesPerRay", "pathLength" };
+    const char* phaseNames[EStatPhaseCount] = { "parse", "meshLoad", "accelBuild", "textureBuild", "render", "write" };
+}
+
+std::mutex Statistics::s_mutex;
+std::vector<std::unique_ptr<Statistics::ThreadStatistics>> Statistics::s_threads;
+
+Statistics::ThreadStatistics* Statistics::registerThread() {
+    std::lock_guard<std::mutex> guard(s_mutex);
+    s_threads.push_back(std::make_unique<ThreadStatistics>());
+    return s_threads.back().get();
+}
+
+std::string Statistics::toJSON() {
+    ThreadStatistics total;
+    {
+        std::lock_guard<std::mutex> guard(s_mutex);
+        for (const auto& entry : s_threads) {
+            const ThreadStatistics& stats = *entry;
+            for (int i = 0; i < EStatCounterCount; i++)
+                total.counters[i] += stats.counters[i];
+            for (int i = 0; i < EStatHistogramCount; i++) {
+                for (int j = 0; j < LUMINA_STAT_BUCKETS; j++)
+                    total.buckets[i][j] += stats.buckets[i][j];
+                total.sums[i] += stats.sums[i];
+                total.maxima[i] = std::max(total.maxima[i], stats.maxima[i]);
+            }
+            for (int i = 0; i < EStatPhaseCount; i++)
+                total.phases[i] += stats.phases[i];
+        }
+    }
+
+    std::ostringstream os;
+    os << "{\n  \"counters\": {";
+    for (int i = 0; i < EStatCounterCount; i++)
+        os << (i > 0 ? "," : "") << "\n    \"" << counterNames[i] << "\": " << total.counters[i];
+
+    /* Closest-hit queries that are not camera rays continue paths */
+    uint64_t bounceRays = total.counters[EIntersectionRays] - std::min(total.counters[EIntersectionRays],
+                                                                       total.counters[ECameraRays]);
+    os << "\n  },\n  \"rays\": {\n    \"camera\": " << total.counters[ECameraRays]
+       << ",\n    \"bounce\": " << bounceRays
+       << ",\n    \"shadow\": " << total.counters[EShadowRays] << "\n  },\n  \"histograms\": {";
+
+    for (int i = 0; i < EStatHistogramCount; i++) {
+        uint64_t count = 0;
+        int lastBucket = -1;
+        for (int j = 0; j < LUMINA_STAT_BUCKETS; j++) {
+            count += total.buckets[i][j];
+            if (total.buckets[i][j] > 0)
+                lastBucket = j;
+        }
+
+        os << (i > 0 ? "," : "") << "\n    \"" << histogramNames[i] << "\": {\n      \"count\": " << count
+           << ",\n      \"mean\": " << tfm::format("%.4f", count > 0 ? (double) total.sums[i] / count : 0.0)
+           << ",\n      \"max\": " << total.maxima[i] << ",\n      \"buckets\": [";
+
+        /* Buckets as [first value, count], empty ones at the end are omitted */
+        for (int j = 0; j <= lastBucket; j++) {
+            uint64_t first = i == EPathLength || j == 0 ? (uint64_t) j : (uint64_t) 1 << (j - 1);
+            os << (j > 0 ? ", " : "") << "[" << first << ", " << total.buckets[i][j] << "]";
+        }
+        os << "]\n    }";
+    }
+
+    os << "\n  },\n  \"phases\": {";
+    for (int i = 0; i < EStatPhaseCount; i++)
+        os << (i > 0 ? "," : "") << "\n    \"" << phaseNames[i] << "\": " << tfm::format("%.6f", total.phases[i]);
+    os << "\n  }\n}\n";
+
+    return os.str();
+}
+#else
+std::string Statistics::toJSON() {
+    return "{}\n";
+}
+#endif
+
+void Statistics::writeJSON(const std::string &filename) {
+    std::ofstream os(filename);
+    os << toJSON();
+    if (!os)
+        throw LuminaException("Unable to write the statistics to \"%s\"", filename);
+}
+
+LUMINA_NAMESPACE_END
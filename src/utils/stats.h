@@ -0,0 +1,197 @@
+//
+// Created by agent on 10/18/26.
+//
+
+#pragma once
+
+#include "core/common.h"
+#include <chrono>
+#include <memory>
+#include <mutex>
+
+/* Statistics are collected unless LUMINA_NO_STATS is defined, in which case all
+   recording functions below are empty and compile to nothing */
+#if !defined(LUMINA_NO_STATS)
+#define LUMINA_HAS_STATS 1
+#endif
+
+/// Number of buckets of every histogram
+#define LUMINA_STAT_BUCKETS 64
+
+LUMINA_NAMESPACE_BEGIN
+
+enum EStatCounter {
+    /// Camera rays generated by \ref Camera::sampleRay()
+    ECameraRays = 0,
+    /// Closest-hit queries (camera rays included)
+    EIntersectionRays,
+    /// Any-hit (occlusion) queries
+    EShadowRays,
+    /// Paths ended by Russian roulette
+    ERussianRouletteTerminations,
+    /// NaN, infinite or negative samples dropped by \ref ImageBlock::put()
+    EInvalidSamples,
+    EStatCounterCount
+};
+
+enum EStatHistogram {
+    /// Nodes visited per traversal, in power-of-two buckets
+    ENodesPerRay = 0,
+    /// Triangles tested per traversal, in power-of-two buckets
+    ETrianglesPerRay,
+    /// Number of bounces of every path, one bucket per length
+    EPathLength,
+    EStatHistogramCount
+};
+
+enum EStatPhase {
+    EPhaseParse = 0,
+    EPhaseMeshLoad,
+    EPhaseAccelBuild,
+    EPhaseTextureBuild,
+    EPhaseRender,
+    EPhaseWrite,
+    EStatPhaseCount
+};
+
+/**
+ * \brief Counters, histograms and phase timings of a run
+ *
+ * Every thread records into its own copy, the copies are only merged
+ * by \ref toJSON(). Phases are exclusive: the time spent loading meshes
+ * while parsing the scene is not counted as parse time.
+ */
+class Statistics {
+public:
+#if defined(LUMINA_HAS_STATS)
+    static void count(EStatCounter counter, uint64_t amount = 1) { local().counters[counter] += amount; }
+
+    static void sample(EStatHistogram histogram, uint64_t value) { local().sample(histogram, value); }
+
+    /// Record the work of a traversal, see \ref RayStatistics
+    static void sampleTraversal(uint64_t nodes, uint64_t triangles) {
+        ThreadStatistics& stats = local();
+        stats.sample(ENodesPerRay, nodes);
+        stats.sample(ETrianglesPerRay, triangles);
+    }
+
+    static void addTime(EStatPhase phase, double seconds) { local().phases[phase] += seconds; }
+#else
+    static void count(EStatCounter, uint64_t = 1) { }
+    static void sample(EStatHistogram, uint64_t) { }
+    static void sampleTraversal(uint64_t, uint64_t) { }
+    static void addTime(EStatPhase, double) { }
+#endif
+
+    /// Merge the statistics of all threads into a JSON document
+    static std::string toJSON();
+
+    /// Write \ref toJSON() to a file
+    static void writeJSON(const std::string& filename);
+
+private:
+#if defined(LUMINA_HAS_STATS)
+    struct ThreadStatistics {
+        uint64_t counters[EStatCounterCount] = {};
+        uint64_t buckets[EStatHistogramCount][LUMINA_STAT_BUCKETS] = {};
+        uint64_t sums[EStatHistogramCount] = {};
+        uint64_t maxima[EStatHistogramCount] = {};
+        double phases[EStatPhaseCount] = {};
+
+        void sample(EStatHistogram histogram, uint64_t value) {
+            buckets[histogram][getBucket(histogram, value)]++;
+            sums[histogram] += value;
+            maxima[histogram] = std::max(maxima[histogram], value);
+        }
+    };
+
+    static ThreadStatistics& local() {
+        static thread_local ThreadStatistics* stats = nullptr;
+        if (!stats)
+            stats = registerThread();
+        return *stats;
+    }
+
+    /// Allocate the statistics of the calling thread, which outlive the thread
+    static ThreadStatistics* registerThread();
+
+    static std::mutex s_mutex;
+    static std::vector<std::unique_ptr<ThreadStatistics>> s_threads;
+
+    static int getBucket(EStatHistogram histogram, uint64_t value) {
+        if (histogram == EPathLength || value == 0)
+            return (int) std::min(value, (uint64_t) LUMINA_STAT_BUCKETS - 1);
+
+        /* Bucket k > 0 holds [2^(k-1), 2^k) */
+        int bucket = 1;
+        while (value >>= 1)
+            bucket++;
+        return std::min(bucket, LUMINA_STAT_BUCKETS - 1);
+    }
+#endif
+};
+
+/**
+ * \brief Attribute the time until the end of the scope to a phase
+ *
+ * A phase started while another one is running on the same thread
+ * pauses the outer one until it ends.
+ */
+class StatPhase {
+public:
+#if defined(LUMINA_HAS_STATS)
+    explicit StatPhase(EStatPhase phase) : m_phase(phase), m_parent(current()) {
+        if (m_parent)
+            m_parent->stop();
+        current() = this;
+        m_start = std::chrono::steady_clock::now();
+    }
+
+    ~StatPhase() {
+        stop();
+        current() = m_parent;
+        if (m_parent)
+            m_parent->m_start = std::chrono::steady_clock::now();
+    }
+#else
+    explicit StatPhase(EStatPhase) { }
+#endif
+
+    StatPhase(const StatPhase&) = delete;
+    StatPhase& operator=(const StatPhase&) = delete;
+
+private:
+#if defined(LUMINA_HAS_STATS)
+    void stop() {
+        Statistics::addTime(m_phase, std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count());
+    }
+
+    static StatPhase*& current() {
+        static thread_local StatPhase* phase = nullptr;
+        return phase;
+    }
+
+    EStatPhase m_phase;
+    StatPhase* m_parent;
+    std::chrono::steady_clock::time_point m_start;
+#endif
+};
+
+/// Work done by a single traversal, recorded when it goes out of scope
+struct RayStatistics {
+#if defined(LUMINA_HAS_STATS)
+    uint32_t nodes = 0, triangles = 0;
+
+    ~RayStatistics() {
+        Statistics::sampleTraversal(nodes, triangles);
+    }
+
+    void visitNode() { nodes++; }
+    void testTriangles(uint32_t count) { triangles += count; }
+#else
+    void visitNode() { }
+    void testTriangles(uint32_t) { }
+#endif
+};
+
+LUMINA_NAMESPACE_END
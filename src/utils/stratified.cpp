@@ -0,0 +1,81 @@
+//
+// Created by agent on 10/18/26.
+//
+
+#include "sampler.h"
+#include "lowDiscrepancy.h"
+
+LUMINA_NAMESPACE_BEGIN
+
+/**
+ * \brief Jittered stratified sampler
+ *
+ * Every dimension of the samples of a pixel is stratified on its own:
+ * 1D values fall into distinct intervals of [0, 1), 2D values into
+ * distinct cells of a square grid over [0, 1)^2. Each pixel and dimension
+ * assigns strata to sample indices with a different random permutation,
+ * so that dimensions and neighbouring pixels are uncorrelated.
+ *
+ * Properties: \c sampleCount, \c jitter (default true, otherwise values
+ * are centered in their stratum) and \c seed.
+ */
+class Stratified : public Sampler {
+public:
+    Stratified(const PropertyList& propsList) {
+        m_sampleCount = (size_t) propsList.getInteger("sampleCount", 1);
+        m_jitter = propsList.getBoolean("jitter", true);
+        m_seed = (uint32_t) propsList.getInteger("seed", 0);
+        m_gridSize = (uint32_t) std::ceil(std::sqrt((double) m_sampleCount));
+    }
+
+    std::unique_ptr<Sampler> clone() const {
+        return std::unique_ptr<Sampler>(new Stratified(*this));
+    }
+
+    float next1D() {
+        uint64_t hash = hashSample(m_pixel, m_dimension++, m_seed);
+        uint32_t count = (uint32_t) m_sampleCount;
+        uint32_t stratum = permutationElement(getIndex(count), count, (uint32_t) hash);
+
+        return std::min((stratum + getJitter(hash >> 32)) / count, LUMINA_ONE_MINUS_EPSILON);
+    }
+
+    Point2f next2D() {
+        uint64_t hash = hashSample(m_pixel, m_dimension, m_seed);
+        m_dimension += 2;
+
+        /* With a sample count that is not a square, some cells stay empty */
+        uint32_t count = m_gridSize * m_gridSize;
+        uint32_t stratum = permutationElement(getIndex(count), count, (uint32_t) hash);
+        uint64_t jitterHash = mixBits(hash);
+
+        return Point2f(
+                std::min((stratum % m_gridSize + getJitter(jitterHash)) / m_gridSize, LUMINA_ONE_MINUS_EPSILON),
+                std::min((stratum / m_gridSize + getJitter(jitterHash >> 32)) / m_gridSize, LUMINA_ONE_MINUS_EPSILON)
+        );
+    }
+
+    std::string toString() const {
+        return tfm::format("Stratified[sampleCount=%i, jitter=%s, seed=%i]", m_sampleCount,
+                           m_jitter ? "true" : "false", m_seed);
+    }
+private:
+    /// Index of the current sample among \c count strata, later rounds reuse them
+    uint32_t getIndex(uint32_t count) const {
+        return (uint32_t) (m_sampleIndex % count);
+    }
+
+    /// Offset within a stratum, specific to the current sample
+    float getJitter(uint64_t hash) const {
+        if (!m_jitter)
+            return 0.5f;
+        return toUnitFloat((uint32_t) mixBits(hash ^ m_sampleIndex));
+    }
+
+    bool m_jitter;
+    uint32_t m_seed;
+    uint32_t m_gridSize;
+};
+
+LUMINA_REGISTER_CLASS(Stratified, "stratified")
+LUMINA_NAMESPACE_END
@@ -0,0 +1,41 @@
+//
+// Created by agent on 10/18/26.
+//
+
+#pragma once
+
+#include "core/object.h"
+
+LUMINA_NAMESPACE_BEGIN
+
+/**
+ * \brief Superclass of the consistency tests
+ *
+ * A test runs when the parser activates it, from a file with a
+ * <tt>&lt;test type="..."&gt;</tt> root (see scenes/pa5/tests). Subclasses
+ * only implement \ref run(); the summary and the exception that makes the
+ * run fail are shared.
+ */
+class Test : public LuminaObject {
+public:
+    /// Run the checks and throw if any of them failed
+    void activate() {
+        int failures = run();
+
+        std::cout << "------------------------------------------------------" << std::endl;
+        if (failures > 0)
+            throw LuminaException("%s failed %i checks", getName(), failures);
+        std::cout << "Passed all " << getName() << " checks." << std::endl;
+    }
+
+    EClassType getClassType() const { return ETest; }
+
+protected:
+    /// Perform the checks, printing the ones that fail, and return how many failed
+    virtual int run() = 0;
+
+    /// Name of the test in the summary
+    virtual std::string getName() const = 0;
+};
+
+LUMINA_NAMESPACE_END
@@ -5,6 +5,8 @@
 #include "warp.h"
 #include "primitives/vector.h"
 
+#include <Eigen/Geometry>
+
 LUMINA_NAMESPACE_BEGIN
 
 Vector3f Warp::squareToCosineHemisphere(const Point2f& sample) {
@@ -73,4 +75,61 @@ float Warp::squareToTrianglePdf(const Vector3f &v) {
     return 0;
 }
 
+namespace {
+    float safeSqrt(float value) { return std::sqrt(std::max(value, 0.0f)); }
+
+    /// Angle between two unit vectors, accurate for nearly (anti)parallel ones
+    float angleBetween(const Vector3f& a, const Vector3f& b) {
+        if (a.dot(b) < 0)
+            return M_PI - 2 * std::asin(std::min((a + b).norm() / 2, 1.0f));
+        return 2 * std::asin(std::min((b - a).norm() / 2, 1.0f));
+    }
+
+    /// Component of \c v orthogonal to the unit vector \c w, normalized
+    Vector3f orthogonalize(const Vector3f& v, const Vector3f& w) {
+        return (v - v.dot(w) * w).normalized();
+    }
+}
+
+Vector3f Warp::squareToSphericalTriangle(const Point2f &sample, const Vector3f &a, const Vector3f &b, const Vector3f &c) {
+    Vector3f nAB = a.cross(b), nBC = b.cross(c), nCA = c.cross(a);
+    if (nAB.squaredNorm() == 0 || nBC.squaredNorm() == 0 || nCA.squaredNorm() == 0)
+        return Vector3f(0.0f);
+    nAB.normalize();
+    nBC.normalize();
+    nCA.normalize();
+
+    /* Interior angles, their excess over pi is the area */
+    float alpha = angleBetween(nAB, -nCA);
+    float beta = angleBetween(nBC, -nAB);
+    float gamma = angleBetween(nCA, -nBC);
+    float area = alpha + beta + gamma - M_PI;
+    if (area <= 0)
+        return Vector3f(0.0f);
+
+    /* Choose the sub-triangle with area sample.x() * area, which fixes the vertex cp on the arc from a to c */
+    float areaP = M_PI + sample.x() * area;
+    float cosAlpha = std::cos(alpha), sinAlpha = std::sin(alpha);
+    float sinPhi = std::sin(areaP) * cosAlpha - std::cos(areaP) * sinAlpha;
+    float cosPhi = std::cos(areaP) * cosAlpha + std::sin(areaP) * sinAlpha;
+
+    float k1 = cosPhi + cosAlpha;
+    float k2 = sinPhi - sinAlpha * a.dot(b);
+    float cosBp = (k2 + (k2 * cosPhi - k1 * sinPhi) * cosAlpha) / ((k2 * sinPhi + k1 * cosPhi) * sinAlpha);
+    cosBp = std::min(std::max(cosBp, -1.0f), 1.0f);
+    float sinBp = safeSqrt(1 - cosBp * cosBp);
+    Vector3f cp = cosBp * a + sinBp * orthogonalize(c, a);
+
+    /* Then a point on the arc from b to cp */
+    float cosTheta = 1 - sample.y() * (1 - cp.dot(b));
+    float sinTheta = safeSqrt(1 - cosTheta * cosTheta);
+    return (cosTheta * b + sinTheta * orthogonalize(cp, b)).normalized();
+}
+
+float Warp::squareToSphericalTrianglePdf(const Vector3f &a, const Vector3f &b, const Vector3f &c) {
+    /* Van Oosterom and Strackee, "The Solid Angle of a Plane Triangle" */
+    float solidAngle = std::abs(2 * std::atan2(a.dot(b.cross(c)), 1 + a.dot(b) + a.dot(c) + b.dot(c)));
+    return solidAngle > 0 ? 1.0f / solidAngle : 0.0f;
+}
+
 LUMINA_NAMESPACE_END
\ No newline at end of file
@@ -17,6 +17,16 @@ namespace Warp {
 
     Vector3f squareToTriangle(const Point2f& sample);
     float squareToTrianglePdf(const Vector3f& v);
+
+    /**
+     * \brief Uniformly sample a direction in the spherical triangle spanned by three unit vectors
+     *
+     * Arvo, "Stratified Sampling of Spherical Triangles" (1995). Returns a
+     * zero vector for degenerate triangles.
+     */
+    Vector3f squareToSphericalTriangle(const Point2f& sample, const Vector3f& a, const Vector3f& b, const Vector3f& c);
+    /// Density of \ref squareToSphericalTriangle(), the inverse of the solid angle of the triangle
+    float squareToSphericalTrianglePdf(const Vector3f& a, const Vector3f& b, const Vector3f& c);
 };
 
 LUMINA_NAMESPACE_END